@@ -0,0 +1,364 @@
+/*  pwn - simple multiplayer chess game
+ *
+ *  Copyright (C) 2020 Jona Ackerschott
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/* pwn-analyze - search every position of a list of FEN or EPD lines,
+   to triage large sets of positions */
+
+#define _XOPEN_SOURCE 700
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <pthread.h>
+
+#include "game.h"
+#include "notation.h"
+#include "pwn.h"
+#include "search.h"
+#include "util.h"
+
+#define DEPTH_DEFAULT 8
+#define THREADS_MAX 256
+#define HASHTABLE_MB_DEFAULT 8
+
+/* a position to search, results are printed in input order as soon as
+   all positions before are done */
+enum {
+	JOB_ERR_NONE,
+	JOB_ERR_POSITION,
+	JOB_ERR_SEARCH,
+};
+struct job_t {
+	char *fen;
+	int nline;
+
+	int done;
+	int err; /* one of the JOB_ERR_* */
+	int check;
+	struct search_result_t res;
+};
+struct jobqueue_t {
+	struct search_limits_t limits;
+	size_t ttsize;
+
+	struct job_t *jobs;
+	int njobs;
+	int nnext;
+	int nprinted;
+	unsigned long long nnodes;
+	pthread_mutex_t lock;
+};
+
+/* EPD has no move counters, the first four fields are the position and
+   operations like "bm Nf3; id 1;" follow. Counters given after them
+   like in a FEN are kept */
+static char *normalize_position(const char *line)
+{
+	const char *fields[6];
+	size_t lens[6];
+	int nfields = 0;
+	const char *c = line;
+	while (nfields < 6) {
+		while (isspace(*c))
+			++c;
+		if (*c == '\0')
+			break;
+
+		fields[nfields] = c;
+		while (*c != '\0' && !isspace(*c))
+			++c;
+		lens[nfields] = c - fields[nfields];
+		++nfields;
+	}
+	if (nfields < 4)
+		return NULL;
+
+	int counters = nfields == 6;
+	for (int k = 4; k < nfields; ++k) {
+		for (size_t l = 0; l < lens[k]; ++l)
+			counters &= isdigit(fields[k][l]) != 0;
+	}
+
+	char *fen = malloc(FEN_BUFSIZE);
+	if (!fen)
+		return NULL;
+
+	char *f = fen;
+	int nkept = counters ? 6 : 4;
+	for (int k = 0; k < nkept; ++k) {
+		if (f - fen + lens[k] + STRLEN(" 0 1") + 1 >= FEN_BUFSIZE) {
+			free(fen);
+			return NULL;
+		}
+		memcpy(f, fields[k], lens[k]);
+		f += lens[k];
+		*f++ = ' ';
+	}
+	strcpy(f - 1, counters ? "" : " 0 1");
+	return fen;
+}
+static int read_jobs(FILE *file, struct job_t **jobs)
+{
+	int njobs = 0;
+	int size = 0;
+	/* EPD operations make lines of any length, read them whole so they
+	   are never split into bogus jobs */
+	char *line = NULL;
+	size_t linesize = 0;
+	for (int nline = 1; getline(&line, &linesize, file) != -1; ++nline) {
+		char *c = line;
+		while (isspace(*c))
+			++c;
+		if (*c == '\0' || *c == '#')
+			continue;
+
+		char *fen = normalize_position(c);
+		if (!fen) {
+			fprintf(stderr, "line %i: not a position\n", nline);
+			continue;
+		}
+
+		if (njobs == size) {
+			size = size ? 2 * size : 1024;
+			struct job_t *j = realloc(*jobs, size * sizeof(**jobs));
+			if (!j) {
+				free(fen);
+				free(line);
+				return -1;
+			}
+			*jobs = j;
+		}
+		memset(&(*jobs)[njobs], 0, sizeof(**jobs));
+		(*jobs)[njobs].fen = fen;
+		(*jobs)[njobs].nline = nline;
+		++njobs;
+	}
+	free(line);
+	if (ferror(file))
+		return -1;
+	return njobs;
+}
+
+static void print_job(const struct job_t *job)
+{
+	if (job->err == JOB_ERR_POSITION) {
+		fprintf(stderr, "line %i: invalid position\n", job->nline);
+		return;
+	} else if (job->err == JOB_ERR_SEARCH) {
+		fprintf(stderr, "line %i: search failed\n", job->nline);
+		return;
+	}
+
+	/* the position part of the fen, without the move counters */
+	const char *c = job->fen;
+	for (int k = 0; k < 4; ++k)
+		c = strchr(c, ' ') + 1;
+	printf("%.*s", (int)(c - job->fen - 1), job->fen);
+
+	const struct search_result_t *res = &job->res;
+	if (res->move == MOVE_NONE) {
+		printf(" ce %i; acd 0; acn 0;\n", job->check ? -SCORE_MATE : 0);
+		return;
+	}
+
+	char move[MOVE_COORD_MAXLEN + 1];
+	move[format_move_coordinates(res->move, move)] = '\0';
+	printf(" bm %s; ce %i;", move, res->score);
+	if (res->score >= SCORE_MATE - SEARCH_PLY_MAX)
+		printf(" dm %i;", (SCORE_MATE - res->score + 1) / 2);
+	printf(" acd %i; acn %lu;\n", res->depth, res->nodes);
+}
+static struct job_t *take_job(struct jobqueue_t *q)
+{
+	pthread_mutex_lock(&q->lock);
+	struct job_t *job = q->nnext < q->njobs ? &q->jobs[q->nnext++] : NULL;
+	pthread_mutex_unlock(&q->lock);
+	return job;
+}
+static void finish_job(struct jobqueue_t *q, struct job_t *job)
+{
+	pthread_mutex_lock(&q->lock);
+	job->done = 1;
+	q->nnodes += job->res.nodes;
+	for (; q->nprinted < q->njobs && q->jobs[q->nprinted].done; ++q->nprinted)
+		print_job(&q->jobs[q->nprinted]);
+	pthread_mutex_unlock(&q->lock);
+}
+
+static void *analyze_thread(void *args)
+{
+	struct jobqueue_t *q = args;
+
+	/* every thread searches with its own game and table, nothing is
+	   shared but the queue */
+	game_t *g = game_create(STARTPOS_FEN);
+	search_t *s = search_create(q->ttsize);
+	if (!g || !s) {
+		if (g)
+			game_destroy(g);
+		return (void *)1;
+	}
+
+	struct job_t *job;
+	while ((job = take_job(q))) {
+		if (game_load_fen_r(g, job->fen)) {
+			job->err = JOB_ERR_POSITION;
+			finish_job(q, job);
+			continue;
+		}
+
+		/* a fresh table keeps the results independent of which
+		   positions a thread happened to search before */
+		search_clear(s);
+		if (search_run(s, g, &q->limits, &job->res) == -1) {
+			/* the results after this one are still printed */
+			job->err = JOB_ERR_SEARCH;
+			finish_job(q, job);
+			search_destroy(s);
+			game_destroy(g);
+			return (void *)1;
+		}
+		job->check = game_is_check_r(g);
+		finish_job(q, job);
+	}
+
+	search_destroy(s);
+	game_destroy(g);
+	return NULL;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: pwn-analyze [-j threads] [-H hashsize in MB] "
+			"[-d depth] [-n nodes] [-w weights] [file]\n");
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	long nthreads = 1;
+	long hashmb = HASHTABLE_MB_DEFAULT;
+	long depth = 0;
+	long nodes = 0;
+	const char *weights = NULL;
+	int c;
+	while ((c = getopt(argc, argv, "j:H:d:n:w:")) != -1) {
+		char *e;
+		switch (c) {
+		case 'j':
+			e = parse_number(optarg, &nthreads);
+			if (!e || *e != '\0' || nthreads < 1 || nthreads > THREADS_MAX)
+				usage();
+			break;
+		case 'H':
+			e = parse_number(optarg, &hashmb);
+			if (!e || *e != '\0' || hashmb < 1 || hashmb > (1L << 20))
+				usage();
+			break;
+		case 'd':
+			e = parse_number(optarg, &depth);
+			if (!e || *e != '\0' || depth < 1 || depth > SEARCH_DEPTH_MAX)
+				usage();
+			break;
+		case 'n':
+			e = parse_number(optarg, &nodes);
+			if (!e || *e != '\0' || nodes < 1)
+				usage();
+			break;
+		case 'w':
+			weights = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc > 1)
+		usage();
+	if (!depth && !nodes)
+		depth = DEPTH_DEFAULT;
+
+	if (weights && game_load_network(weights)) {
+		fprintf(stderr, "could not load network weights from '%s'\n", weights);
+		exit(1);
+	}
+
+	FILE *file = stdin;
+	if (argc == 1 && !(file = fopen(argv[0], "r"))) {
+		fprintf(stderr, "could not open '%s'\n", argv[0]);
+		exit(1);
+	}
+
+	struct jobqueue_t q;
+	memset(&q, 0, sizeof(q));
+	q.limits.depth = depth;
+	q.limits.nodes = nodes;
+	q.ttsize = (size_t)hashmb << 20;
+	q.njobs = read_jobs(file, &q.jobs);
+	if (file != stdin)
+		fclose(file);
+	if (q.njobs == -1) {
+		SYSERR();
+		exit(1);
+	}
+	pthread_mutex_init(&q.lock, NULL);
+
+	long t = measure_time();
+
+	int err = 0;
+	pthread_t threads[THREADS_MAX];
+	int nstarted = 0;
+	for (; nstarted < nthreads; ++nstarted) {
+		if (pthread_create(&threads[nstarted], NULL, analyze_thread, &q)) {
+			err = 1;
+			break;
+		}
+	}
+	for (int k = 0; k < nstarted; ++k) {
+		void *ret;
+		pthread_join(threads[k], &ret);
+		err |= ret != NULL;
+	}
+	pthread_mutex_destroy(&q.lock);
+	if (err) {
+		fprintf(stderr, "could not run all analysis threads\n");
+		exit(1);
+	}
+
+	t = measure_time() - t;
+	fflush(stdout);
+
+	fprintf(stderr, "\npositions: %i\n", q.njobs);
+	fprintf(stderr, "nodes: %llu\n", q.nnodes);
+	fprintf(stderr, "threads: %li\n", nthreads);
+	fprintf(stderr, "time: %.3f s\n", (double)t / SECOND);
+	if (t > 0) {
+		fprintf(stderr, "positions per second: %.1f\n", (double)q.njobs * SECOND / t);
+		fprintf(stderr, "nps: %.0f\n", (double)q.nnodes * SECOND / t);
+	}
+
+	for (int k = 0; k < q.njobs; ++k)
+		free(q.jobs[k].fen);
+	free(q.jobs);
+	return 0;
+}
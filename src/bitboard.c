@@ -0,0 +1,130 @@
+/*  pwn - simple multiplayer chess game
+ *
+ *  Copyright (C) 2020 Jona Ackerschott
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "bitboard.h"
+#include "cpu.h"
+#include "tables.h"
+
+#ifdef HAVE_SIMD
+#define HAVE_PEXT
+#endif
+
+static const bitboard_t *rook_table = rook_table_magic;
+static const bitboard_t *bishop_table = bishop_table_magic;
+
+static int slider_method = -1;
+
+/* the first blocker on a ray cuts off the part of the ray behind it */
+static bitboard_t ray_attacks(int s, bitboard_t occ, int dir)
+{
+	bitboard_t b = rays[dir][s];
+	bitboard_t blockers = b & occ;
+	if (!blockers)
+		return b;
+	int blocker = dir < RAYS_NUM / 2 ? BB_LSB(blockers) : 63 - __builtin_clzll(blockers);
+	return b ^ rays[dir][blocker];
+}
+static bitboard_t rook_attacks_rays(int s, bitboard_t occ)
+{
+	return ray_attacks(s, occ, RAY_EAST) | ray_attacks(s, occ, RAY_NORTH)
+		| ray_attacks(s, occ, RAY_WEST) | ray_attacks(s, occ, RAY_SOUTH);
+}
+static bitboard_t bishop_attacks_rays(int s, bitboard_t occ)
+{
+	return ray_attacks(s, occ, RAY_NORTHEAST) | ray_attacks(s, occ, RAY_NORTHWEST)
+		| ray_attacks(s, occ, RAY_SOUTHWEST) | ray_attacks(s, occ, RAY_SOUTHEAST);
+}
+
+static unsigned int magic_index(const struct magic_t *m, bitboard_t occ)
+{
+	return m->offset + (((occ & m->mask) * m->magic) >> m->shift);
+}
+static bitboard_t rook_attacks_magic(int s, bitboard_t occ)
+{
+	return rook_table[magic_index(&rook_magics[s], occ)];
+}
+static bitboard_t bishop_attacks_magic(int s, bitboard_t occ)
+{
+	return bishop_table[magic_index(&bishop_magics[s], occ)];
+}
+
+#ifdef HAVE_PEXT
+__attribute__((target("bmi2")))
+static bitboard_t rook_attacks_pext(int s, bitboard_t occ)
+{
+	const struct magic_t *m = &rook_magics[s];
+	return rook_table[m->offset + _pext_u64(occ, m->mask)];
+}
+__attribute__((target("bmi2")))
+static bitboard_t bishop_attacks_pext(int s, bitboard_t occ)
+{
+	const struct magic_t *m = &bishop_magics[s];
+	return bishop_table[m->offset + _pext_u64(occ, m->mask)];
+}
+#endif
+
+/* the lookups are chosen once here instead of on every call, magic
+   until bb_init() or bb_set_slider_method() says otherwise */
+bitboard_t (*bb_rook_attacks)(int s, bitboard_t occ) = rook_attacks_magic;
+bitboard_t (*bb_bishop_attacks)(int s, bitboard_t occ) = bishop_attacks_magic;
+
+int bb_set_slider_method(int method)
+{
+#ifdef HAVE_PEXT
+	if (method == BB_SLIDERS_PEXT && !cpu_has_bmi2())
+		return 1;
+#else
+	if (method == BB_SLIDERS_PEXT)
+		return 1;
+#endif
+
+	/* magic and pext order the subsets differently, so each has its
+	   own tables */
+	slider_method = method;
+	if (method == BB_SLIDERS_RAYS) {
+		bb_rook_attacks = rook_attacks_rays;
+		bb_bishop_attacks = bishop_attacks_rays;
+#ifdef HAVE_PEXT
+	} else if (method == BB_SLIDERS_PEXT) {
+		rook_table = rook_table_pext;
+		bishop_table = bishop_table_pext;
+		bb_rook_attacks = rook_attacks_pext;
+		bb_bishop_attacks = bishop_attacks_pext;
+#endif
+	} else {
+		rook_table = rook_table_magic;
+		bishop_table = bishop_table_magic;
+		bb_rook_attacks = rook_attacks_magic;
+		bb_bishop_attacks = bishop_attacks_magic;
+	}
+	return 0;
+}
+int bb_get_slider_method(void)
+{
+	return slider_method;
+}
+
+/* magic lookups beat pext on the attack benchmark and pext is microcoded
+   on older AMD cores, so pext is only used when asked for */
+void bb_init(void)
+{
+	if (slider_method != -1)
+		return;
+
+	bb_set_slider_method(BB_SLIDERS_MAGIC);
+}
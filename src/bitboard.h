@@ -0,0 +1,62 @@
+/*  pwn - simple multiplayer chess game
+ *
+ *  Copyright (C) 2020 Jona Ackerschott
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include <stdint.h>
+
+#include "game.h"
+
+typedef uint64_t bitboard_t;
+
+#define BB(s) ((bitboard_t)1 << (s))
+#define BB_FILE_A 0x0101010101010101ULL
+#define BB_RANK_1 0x00000000000000ffULL
+#define BB_FILE(i) (BB_FILE_A << (i))
+#define BB_RANK(j) (BB_RANK_1 << (NF * (j)))
+
+#define BB_POPCOUNT(b) __builtin_popcountll(b)
+#define BB_LSB(b) __builtin_ctzll(b)
+
+/* ways of looking up sliding piece attacks */
+enum {
+	BB_SLIDERS_RAYS,
+	BB_SLIDERS_MAGIC,
+	BB_SLIDERS_PEXT,
+};
+
+/* generated at build time, see gentables.c */
+extern const bitboard_t knight_attacks[SQUARES_NUM];
+extern const bitboard_t king_attacks[SQUARES_NUM];
+extern const bitboard_t pawn_attacks[COLORS_NUM][SQUARES_NUM];
+
+/* squares strictly between two aligned squares and the whole line
+   through them, both empty if the squares are not on a common line */
+extern const bitboard_t squares_between[SQUARES_NUM][SQUARES_NUM];
+extern const bitboard_t squares_line[SQUARES_NUM][SQUARES_NUM];
+
+void bb_init(void);
+int bb_set_slider_method(int method);
+int bb_get_slider_method(void);
+
+/* point to the lookup of the current slider method */
+extern bitboard_t (*bb_rook_attacks)(int s, bitboard_t occ);
+extern bitboard_t (*bb_bishop_attacks)(int s, bitboard_t occ);
+
+#endif /* BITBOARD_H */
@@ -0,0 +1,53 @@
+/*  pwn - simple multiplayer chess game
+ *
+ *  Copyright (C) 2020 Jona Ackerschott
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef BOOK_H
+#define BOOK_H
+
+#include <stdint.h>
+
+#include "game.h"
+
+/* polyglot opening books: sorted entries of 16 big endian bytes, a
+   position key of 8 bytes, the move, its weight and 4 bytes of learning
+   data. Keys are polyglot's own zobrist keys, not the ones of game.c */
+#define BOOK_ENTRY_SIZE 16
+
+typedef struct book_t book_t;
+
+struct book_entry_t {
+	/* target of castling moves is the square of the rook */
+	move_t move;
+	unsigned int weight;
+};
+
+/* the entries stay in the mapped file, processes opening the same book
+   share them. Returns NULL if the file could not be mapped or is not a
+   sequence of entries */
+book_t *book_open(const char *fname);
+void book_close(book_t *b);
+
+/* the castlerights are given like in game_t, epfile is -1 unless the
+   side to move can capture en passant */
+uint64_t book_key(const uint8_t mailbox[SQUARES_NUM], color_t c,
+		const int castlerights[COLORS_NUM], int epfile);
+
+/* the entries of a position, at most n */
+int book_probe(const book_t *b, uint64_t key, struct book_entry_t *entries, int n);
+
+#endif /* BOOK_H */
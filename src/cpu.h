@@ -0,0 +1,64 @@
+/*  pwn - simple multiplayer chess game
+ *
+ *  Copyright (C) 2020 Jona Ackerschott
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/* runtime detection of the vector extensions the kernels are built for */
+
+#ifndef CPU_H
+#define CPU_H
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_SIMD
+#include <cpuid.h>
+#include <immintrin.h>
+
+static inline int cpu_has_sse2(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return 0;
+	return (edx & bit_SSE2) != 0;
+}
+/* feature bits of the structured extended feature leaf in ebx */
+static inline unsigned int cpu_extended_features(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+	if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+		return 0;
+	return ebx;
+}
+static inline int cpu_has_avx2(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_OSXSAVE))
+		return 0;
+
+	/* the os has to save the upper halves of the ymm registers */
+	unsigned int xcr0, xcr0hi;
+	__asm__ ("xgetbv" : "=a" (xcr0), "=d" (xcr0hi) : "c" (0));
+	if ((xcr0 & 6) != 6)
+		return 0;
+
+	return (cpu_extended_features() & bit_AVX2) != 0;
+}
+static inline int cpu_has_bmi2(void)
+{
+	return (cpu_extended_features() & bit_BMI2) != 0;
+}
+#endif
+
+#endif /* CPU_H */
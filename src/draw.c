@@ -53,6 +53,7 @@ color dark_square_color = COLOR(0xb5, 0x88, 0x63, 0xff);
 
 color selection_overlay_color = COLOR(0x27, 0x44, 0x70, 0xe6);
 color move_involved_overlay_color = COLOR(0x27, 0x44, 0x70, 0x99);
+color legal_target_overlay_color = COLOR(0x27, 0x44, 0x70, 0x4d);
 
 cairo_t *cr;
 
@@ -650,9 +651,11 @@ void draw_square(double x, double y, double size, shade_t shade, square_highligh
 	color d = shade == SHADE_LIGHT ? light_square_color : dark_square_color;
 	color s = selection_overlay_color;
 	color i = move_involved_overlay_color;
+	color t = legal_target_overlay_color;
 	cairo_pattern_t *def = cairo_pattern_create_rgba(d.r, d.g, d.b, d.a);
 	cairo_pattern_t *sel = cairo_pattern_create_rgba(s.r, s.g, s.b, s.a);
 	cairo_pattern_t *inv = cairo_pattern_create_rgba(i.r, i.g, i.b, i.a);
+	cairo_pattern_t *tgt = cairo_pattern_create_rgba(t.r, t.g, t.b, t.a);
 
 	cairo_set_antialias(cr, CAIRO_ANTIALIAS_NONE);
 
@@ -668,10 +671,15 @@ void draw_square(double x, double y, double size, shade_t shade, square_highligh
 		cairo_set_source(cr, inv);
 		cairo_rectangle(cr, x, y, size, size);
 		cairo_fill(cr);
+	} else if (highlight == SQUARE_HIGHLIGHT_LEGAL_TARGET) {
+		cairo_set_source(cr, tgt);
+		cairo_rectangle(cr, x, y, size, size);
+		cairo_fill(cr);
 	}
 
 	cairo_set_antialias(cr, CAIRO_ANTIALIAS_DEFAULT);
 
+	cairo_pattern_destroy(tgt);
 	cairo_pattern_destroy(inv);
 	cairo_pattern_destroy(sel);
 	cairo_pattern_destroy(def);
@@ -31,6 +31,7 @@ enum square_highlight_t {
 	SQUARE_HIGHLIGHT_UNSELECTED = 0,
 	SQUARE_HIGHLIGHT_SELECTED = 1,
 	SQUARE_HIGHLIGHT_MOVE_INVOLVED = 2,
+	SQUARE_HIGHLIGHT_LEGAL_TARGET = 3,
 };
 
 typedef enum shade_t shade_t;
@@ -0,0 +1,235 @@
+/*  pwn - simple multiplayer chess game
+ *
+ *  Copyright (C) 2020 Jona Ackerschott
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <pthread.h>
+
+#include "notation.h"
+#include "pwn.h"
+#include "search.h"
+#include "util.h"
+
+#include "engineh.h"
+
+#define ENGINEH_EVENT_RESPONSE_TIME 10000
+
+/* thinking time per move: a fixed amount without clock, otherwise a
+   share of the time left, as if as many moves were still to be made,
+   plus the increment but never more than half of the time left */
+#define MOVETIME_UNTIMED SECOND
+#define MOVES_TO_GO 30
+#define MOVETIME_MIN (SECOND / 20)
+
+static struct handler_context_t *hctx;
+static int fevent;
+static int fconfirm;
+static int *state;
+static struct pollfd pfd;
+
+static color_t color;
+static long timeleft;
+static long moveinc;
+static game_t *game;
+static search_t *searcher;
+
+static void engineh_cleanup(void);
+
+/* any event while thinking makes the search obsolete, it is either the
+   end of the game or of the program */
+static int has_pending_event(void *arg)
+{
+	if (poll(&pfd, 1, 0) == -1)
+		return 1;
+	return pfd.revents != 0;
+}
+static int search_move(move_t *m)
+{
+	struct search_limits_t limits;
+	memset(&limits, 0, sizeof(limits));
+	if (timeleft) {
+		long t = MIN(timeleft / MOVES_TO_GO + moveinc, timeleft / 2);
+		limits.time = MAX(t, MOVETIME_MIN);
+	} else {
+		limits.time = MOVETIME_UNTIMED;
+	}
+	limits.interrupt = has_pending_event;
+
+	struct search_result_t res;
+	int err = search_run(searcher, game, &limits, &res);
+	if (err == -1) {
+		SYSERR();
+		engineh_cleanup();
+		pthread_exit(NULL);
+	} else if (err == 1 || has_pending_event(NULL)) {
+		return 1;
+	}
+
+	*m = res.move;
+	return 0;
+}
+static void think(void)
+{
+	/* the most weighted book move is played without searching */
+	move_t moves[MOVES_MAX];
+	move_t m;
+	if (game_book_moves_r(game, moves, NULL) > 0)
+		m = moves[0];
+	else if (search_move(&m))
+		return;
+
+	if (game_exec_ply_r(game, m)) {
+		fprintf(stderr, "%s: found illegal move\n", __func__);
+		engineh_cleanup();
+		pthread_exit(NULL);
+	}
+
+	int n = hwrite(fconfirm, &m, sizeof(m));
+	if (n == -1) {
+		SYSERR();
+		engineh_cleanup();
+		pthread_exit(NULL);
+	}
+}
+
+static void handle_playmove(struct engineh_event_playmove *e)
+{
+	int err = game_exec_ply_r(game, e->move);
+	if (err) {
+		fprintf(stderr, "%s: received illegal move\n", __func__);
+		engineh_cleanup();
+		pthread_exit(NULL);
+	}
+	timeleft = e->time;
+}
+static void handle_statuschange(struct engineh_event_statuschange *e)
+{
+	status_t moving = color == COLOR_WHITE ? STATUS_MOVING_WHITE : STATUS_MOVING_BLACK;
+	if (e->status == moving && game_get_active_color_r(game) == color)
+		think();
+}
+
+static void engineh_setup(void)
+{
+	if (fcntl(fevent, F_SETFL, O_NONBLOCK) == -1) {
+		SYSERR();
+		goto cleanup_err;
+	}
+
+	pfd.fd = fevent;
+	pfd.events = POLLIN;
+
+	game = game_create(STARTPOS_FEN);
+	if (!game) {
+		SYSERR();
+		goto cleanup_err;
+	}
+	searcher = search_create(ENGINEH_TT_SIZE);
+	if (!searcher) {
+		SYSERR();
+		game_destroy(game);
+		goto cleanup_err;
+	}
+	return;
+
+cleanup_err:
+	pthread_mutex_lock(&hctx->mainlock);
+	hctx->terminate = 1;
+	pthread_mutex_unlock(&hctx->mainlock);
+	pthread_exit(NULL);
+}
+static void engineh_run(void)
+{
+	/* white starts without being told */
+	if (color == COLOR_WHITE)
+		think();
+
+	union engineh_event_t e;
+	memset(&e, 0, sizeof(e));
+	while (1) {
+		int n = poll(&pfd, 1, 0);
+		if (n == -1) {
+			SYSERR();
+			goto cleanup_err;
+		}
+
+		if (pfd.revents) {
+			n = hread(fevent, &e, sizeof(e));
+			if (n == -1) {
+				SYSERR();
+				goto cleanup_err;
+			} else if (n == 1) {
+				break;
+			}
+
+			switch (e.type) {
+			case ENGINEH_EVENT_PLAYMOVE:
+				handle_playmove(&e.playmove);
+				break;
+			case ENGINEH_EVENT_STATUSCHANGE:
+				handle_statuschange(&e.statuschange);
+				break;
+			default:
+				fprintf(stderr, "%s: received unexpected event\n", __func__);
+				goto cleanup_err;
+			}
+		} else {
+			usleep(ENGINEH_EVENT_RESPONSE_TIME);
+		}
+	}
+	return;
+
+cleanup_err:
+	engineh_cleanup();
+	pthread_exit(NULL);
+}
+static void engineh_cleanup(void)
+{
+	search_destroy(searcher);
+	game_destroy(game);
+
+	if (close(fevent) == -1 || close(fconfirm) == -1)
+		fprintf(stderr, "%s: error while closing event pipes\n", __func__);
+
+	pthread_mutex_lock(&hctx->mainlock);
+	hctx->terminate = 1;
+	pthread_mutex_unlock(&hctx->mainlock);
+}
+void *engineh_main(void *args)
+{
+	struct engineh_args_t *a = (struct engineh_args_t *)args;
+	hctx = a->hctx;
+
+	fevent = hctx->engineh.pevent[0];
+	fconfirm = hctx->engineh.pconfirm[1];
+	state = &hctx->engineh.state;
+	color = a->color;
+	timeleft = a->gametime;
+	moveinc = a->moveinc;
+	free(a);
+
+	engineh_setup();
+	engineh_run();
+	engineh_cleanup();
+	return 0;
+}
@@ -0,0 +1,60 @@
+/*  pwn - simple multiplayer chess game
+ *
+ *  Copyright (C) 2020 Jona Ackerschott
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ENGINEH_H
+#define ENGINEH_H
+
+#include "pwn.h"
+#include "game.h"
+
+#define ENGINEH_TT_SIZE (32 << 20)
+
+enum {
+	ENGINEH_EVENT_PLAYMOVE,
+	ENGINEH_EVENT_STATUSCHANGE,
+};
+/* a move by the player, together with the clock time the engine has
+   left or 0 if the game is played without time */
+struct engineh_event_playmove {
+	int type;
+	move_t move;
+	long time;
+};
+struct engineh_event_statuschange {
+	int type;
+	status_t status;
+};
+union engineh_event_t {
+	int type;
+	struct engineh_event_playmove playmove;
+	struct engineh_event_statuschange statuschange;
+};
+
+struct engineh_args_t {
+	struct handler_context_t *hctx;
+
+	color_t color;
+	long gametime;
+	long moveinc;
+};
+
+/* the computer opponent, it answers with a move_t written to the
+   confirm pipe whenever the status changes to it being on move */
+void *engineh_main(void *args);
+
+#endif /* ENGINEH_H */
@@ -25,8 +25,10 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
-#include <cairo/cairo.h>
-
+#include "bitboard.h"
+#include "book.h"
+#include "mailbox.h"
+#include "nnue.h"
 #include "notation.h"
 
 #include "game.h"
@@ -34,635 +36,1312 @@
 /* pseudolegal = Move is allowed even if king is in check after
    legal = Move is allowed, king is not in check after */
 
-#define HINT_CASTLE 				(1 << 0)
-#define HINT_DEL_CASTLERIGHT_KINGSIDE 		(1 << 1)
-#define HINT_DEL_CASTLERIGHT_QUEENSIDE 		(1 << 2)
-#define HINT_PROMOTION 				(1 << 3)
-#define HINT_EN_PASSANT 			(1 << 4)
-#define HINT_SET_EN_PASSANT_FIELD 		(1 << 5)
-
-/* for testing */
-//#define PLIES_BUFSIZE 4
-#define PLIES_BUFSIZE 64
+/* the ply stack always keeps this many records free beyond the game
+   history, so that trying out moves never needs to allocate */
+#define PLIES_RESERVE 128
 
 #define DRAWISH_MOVES_MAX 50
 
+#define STATUS_UNKNOWN -1
+
+#define PIECES(p) g->pieces[PIECE_IDX(p)]
+#define OCCUPANCY (g->colors[COLOR_WHITE] | g->colors[COLOR_BLACK])
+
+/* color templates: functions ending in _for take the moving color as
+   first argument and are always inlined, BY_COLOR instantiates them for
+   both colors so that ranks and steps derived from it are constants */
+#define TEMPLATE static inline __attribute__((always_inline))
+#define BY_COLOR(c, f, ...) ((c) == COLOR_WHITE ? f(COLOR_WHITE, __VA_ARGS__) \
+		: f(COLOR_BLACK, __VA_ARGS__))
+
+#define BACKRANK(c) ((c) * (NF - 1))
+#define PAWNRANK(c) ((c) * (NF - 3) + 1)
+#define PROMRANK(c) BACKRANK(OPP_COLOR(c))
+#define PAWN_STEP(c) (NF - 2 * NF * (c))
+
+/* material signature: the piece counts of one color packed into nibbles
+   by piece index, bishops on light squares get the extra nibble at the
+   top so that bishop square colors are part of the signature */
+#define MATERIAL_LIGHT_BISHOP PIECES_NUM
+#define MATERIAL_SHIFT(p, s) (4 * ((p) == PIECE_BISHOP && (SQ_FILE(s) + SQ_RANK(s)) % 2 \
+			? MATERIAL_LIGHT_BISHOP : PIECE_IDX(p)))
+#define MATERIAL_NIBBLE(k) ((uint32_t)0xf << (4 * (k)))
+
+enum {
+	PHASE_MIDDLEGAME,
+	PHASE_ENDGAME,
+	PHASES_NUM,
+};
+#define PHASE_MAX 24
+
+#define PACK_CASTLERIGHTS(cr) ((cr)[COLOR_WHITE] | ((cr)[COLOR_BLACK] << 2))
+#define UNPACK_CASTLERIGHTS(packed, cr) do { \
+	(cr)[COLOR_WHITE] = (packed) & 0b11; \
+	(cr)[COLOR_BLACK] = (packed) >> 2; \
+} while (0);
+
+/* everything needed to take a ply back, the board itself is restored
+   incrementally from the squares and pieces involved */
 struct ply_t {
-	piece_t p;
-	sqid from[2];
-	sqid to[2];
-	piece_t taken;
-	piece_t prompiece;
-	sqid fep[2];
+	uint64_t hash;
+	unsigned int ndrawplies;
+	move_t move;
+	unsigned char p;
+	unsigned char taken;
+	unsigned char castlerights;
+	signed char fep;
+
+	/* status of the position after the ply, STATUS_UNKNOWN until first
+	   asked for */
+	signed char status;
+};
+
+/* zobrist keys for pieces, active color, castlerights and en passant
+   field, shared by all games */
+static uint64_t zobrist_pieces[COLORS_NUM][PIECES_NUM][SQUARES_NUM];
+static uint64_t zobrist_castlerights[16];
+static uint64_t zobrist_fep[NF];
+static uint64_t zobrist_black;
+
+struct game_t {
+	/* the board is kept twice: as bitboards for attack and material
+	   queries and as a mailbox for answering "what is on this square",
+	   which takes up exactly one cache line */
+	uint8_t mailbox[SQUARES_NUM] __attribute__((aligned(MAILBOX_ALIGN)));
+	bitboard_t pieces[PIECES_NUM];
+	bitboard_t colors[COLORS_NUM];
+	int kingsq[COLORS_NUM];
+	uint32_t material[COLORS_NUM];
+
+	/* sums of psq_scores[] by game phase, of phase_weights[] and of the
+	   material values for white, see put_piece() */
+	int psq[PHASES_NUM];
+	int phase;
+	int material_balance;
+
+	color_t active_color;
 	int castlerights[2];
-	squareinfo_t position[NF][NF];
-	int ndrawplies;
-	int nmove;
-	int hints;
+	sqid fep[2];
+	unsigned int drawish_plies_num;
+	unsigned int nmove;
+
+	unsigned int pliesnum;
+	unsigned int pliessize;
+	ply_t *plies;
+	unsigned long nallocs;
+
+	/* zobrist key of the position, updated incrementally while plies
+	   are executed */
+	uint64_t hash;
+
+	/* status of the loaded position, as long as no ply is executed */
+	signed char status;
+
+	/* see update_checkinfo() */
+	bitboard_t checkers;
+	bitboard_t pinned;
+	bitboard_t checkmask;
+
+	/* first layer of the network generation the accumulator was built
+	   for, 0 if none, kept up to date by put_piece() and remove_piece() */
+	unsigned long netgen;
+	struct nnue_accumulator_t acc;
+
+	/* legal targets by origin square, valid for the position with key
+	   targetshash until the next ply */
+	bitboard_t targets[SQUARES_NUM];
+	uint64_t targetshash;
+	int targetsvalid;
 };
 
-static squareinfo_t position[NF][NF];
-static color_t active_color;
-static int castlerights[2];
-static sqid fep[2];
-static unsigned int drawish_plies_num;
-static unsigned int nmove;
+enum {
+	MATERIAL_BARE,
+	MATERIAL_KNIGHT,
+	MATERIAL_LIGHT_BISHOPS,
+	MATERIAL_DARK_BISHOPS,
+	MATERIAL_OTHER,
+	MATERIAL_CLASSES_NUM,
+};
+/* can a side with the first material class mate one with the second */
+static const int sufficient_material[MATERIAL_CLASSES_NUM][MATERIAL_CLASSES_NUM] = {
+	[MATERIAL_BARE] =          { 0, 0, 0, 0, 0 },
+	[MATERIAL_KNIGHT] =        { 0, 1, 1, 1, 1 },
+	[MATERIAL_LIGHT_BISHOPS] = { 0, 1, 0, 1, 1 },
+	[MATERIAL_DARK_BISHOPS] =  { 0, 1, 1, 0, 1 },
+	[MATERIAL_OTHER] =         { 1, 1, 1, 1, 1 },
+};
 
-static unsigned int pliesnum;
-static unsigned int pliessize;
-static ply_t *plies;
+/* material values in centipawns by piece index, the king outweighs
+   everything so that exchanges never give it away */
+static const int piece_values[PIECES_NUM] = { 20000, 900, 500, 330, 320, 100 };
+
+/* piece-square bonuses by piece index, laid out as the board is seen by
+   white with the eighth rank on top */
+static const int psqt[PIECES_NUM][SQUARES_NUM] = {
+	{
+		-30, -40, -40, -50, -50, -40, -40, -30,
+		-30, -40, -40, -50, -50, -40, -40, -30,
+		-30, -40, -40, -50, -50, -40, -40, -30,
+		-30, -40, -40, -50, -50, -40, -40, -30,
+		-20, -30, -30, -40, -40, -30, -30, -20,
+		-10, -20, -20, -20, -20, -20, -20, -10,
+		 20,  20,   0,   0,   0,   0,  20,  20,
+		 20,  30,  10,   0,   0,  10,  30,  20,
+	}, {
+		-20, -10, -10,  -5,  -5, -10, -10, -20,
+		-10,   0,   0,   0,   0,   0,   0, -10,
+		-10,   0,   5,   5,   5,   5,   0, -10,
+		 -5,   0,   5,   5,   5,   5,   0,  -5,
+		  0,   0,   5,   5,   5,   5,   0,  -5,
+		-10,   5,   5,   5,   5,   5,   0, -10,
+		-10,   0,   5,   0,   0,   0,   0, -10,
+		-20, -10, -10,  -5,  -5, -10, -10, -20,
+	}, {
+		  0,   0,   0,   0,   0,   0,   0,   0,
+		  5,  10,  10,  10,  10,  10,  10,   5,
+		 -5,   0,   0,   0,   0,   0,   0,  -5,
+		 -5,   0,   0,   0,   0,   0,   0,  -5,
+		 -5,   0,   0,   0,   0,   0,   0,  -5,
+		 -5,   0,   0,   0,   0,   0,   0,  -5,
+		 -5,   0,   0,   0,   0,   0,   0,  -5,
+		  0,   0,   0,   5,   5,   0,   0,   0,
+	}, {
+		-20, -10, -10, -10, -10, -10, -10, -20,
+		-10,   0,   0,   0,   0,   0,   0, -10,
+		-10,   0,   5,  10,  10,   5,   0, -10,
+		-10,   5,   5,  10,  10,   5,   5, -10,
+		-10,   0,  10,  10,  10,  10,   0, -10,
+		-10,  10,  10,  10,  10,  10,  10, -10,
+		-10,   5,   0,   0,   0,   0,   5, -10,
+		-20, -10, -10, -10, -10, -10, -10, -20,
+	}, {
+		-50, -40, -30, -30, -30, -30, -40, -50,
+		-40, -20,   0,   0,   0,   0, -20, -40,
+		-30,   0,  10,  15,  15,  10,   0, -30,
+		-30,   5,  15,  20,  20,  15,   5, -30,
+		-30,   0,  15,  20,  20,  15,   0, -30,
+		-30,   5,  10,  15,  15,  10,   5, -30,
+		-40, -20,   0,   5,   5,   0, -20, -40,
+		-50, -40, -30, -30, -30, -30, -40, -50,
+	}, {
+		  0,   0,   0,   0,   0,   0,   0,   0,
+		 50,  50,  50,  50,  50,  50,  50,  50,
+		 10,  10,  20,  30,  30,  20,  10,  10,
+		  5,   5,  10,  25,  25,  10,   5,   5,
+		  0,   0,   0,  20,  20,   0,   0,   0,
+		  5,  -5, -10,   0,   0, -10,  -5,   5,
+		  5,  10,  10, -20, -20,  10,  10,   5,
+		  0,   0,   0,   0,   0,   0,   0,   0,
+	},
+};
+
+/* the king's bonuses once most pieces are gone, it should come out to
+   the center then */
+static const int psqt_king_endgame[SQUARES_NUM] = {
+	-50, -40, -30, -20, -20, -30, -40, -50,
+	-30, -20, -10,   0,   0, -10, -20, -30,
+	-30, -10,  20,  30,  30,  20, -10, -30,
+	-30, -10,  30,  40,  40,  30, -10, -30,
+	-30, -10,  30,  40,  40,  30, -10, -30,
+	-30, -10,  20,  30,  30,  20, -10, -30,
+	-30, -30,   0,   0,   0,   0, -30, -30,
+	-50, -30, -30, -30, -30, -30, -30, -50,
+};
+
+/* game phase contributed by each piece, PHASE_MAX with all pieces on the
+   board */
+static const int phase_weights[PIECES_NUM] = { 0, 4, 2, 1, 1, 0 };
+
+/* material and piece-square score of a piece on a square for white by
+   game phase, the kings count as nothing */
+static int psq_scores[PHASES_NUM][COLORS_NUM][PIECES_NUM][SQUARES_NUM];
+
+/* network used by game_evaluate_r(), shared by all games. Every load
+   starts a new generation, so that accumulators of earlier networks are
+   never taken for current ones, even if the new network is mapped at
+   the same address */
+static nnue_t *network;
+static unsigned long network_generation;
+
+/* opening book used by game_book_moves_r(), shared by all games */
+static book_t *book;
+
+/* the game behind the non reentrant interface */
+static game_t default_game;
 
 /* debug */
-static void print_hints(int hints);
 static void print_ply(ply_t *m);
 
-static int is_pseudolegal_queen_ply(sqid ifrom, sqid jfrom, sqid ito, sqid jto, int *hints)
+static uint64_t random_key(void)
 {
-	color_t c = position[ifrom][jfrom] & COLORMASK;
-	if (((position[ito][jto] & PIECEMASK) != PIECE_NONE)
-			&& (position[ito][jto] & COLORMASK) == c)
-		return 0;
-
-	if (hints)
-		*hints = 0;
-
-	int di = ito - ifrom;
-	int dj = jto - jfrom;
+	static uint64_t x = 0x9e3779b97f4a7c15ULL;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	return x * 0x2545f4914f6cdd1dULL;
+}
+static void init_zobrist(void)
+{
+	static int initialized;
+	if (initialized)
+		return;
 
-	if (abs(di) == abs(dj)) { /* like bishop */
-		int vi = SGN(ito - ifrom);
-		int vj = SGN(jto - jfrom);
-		for (int k = 1; k < abs(ito - ifrom); ++k) {
-			int i = ifrom + vi * k;
-			int j = jfrom + vj * k;
-			if ((position[i][j] & PIECEMASK) != PIECE_NONE)
-				return 0;
-		}
-		return 1;
-	} else if (di == 0) { /* like rook, vertically */
-		for (int j = MIN(jfrom, jto) + 1; j < MAX(jfrom, jto); ++j) {
-			if ((position[ifrom][j] & PIECEMASK) != PIECE_NONE)
-				return 0;
+	for (int c = 0; c < COLORS_NUM; ++c) {
+		for (int p = 0; p < PIECES_NUM; ++p) {
+			for (int s = 0; s < SQUARES_NUM; ++s)
+				zobrist_pieces[c][p][s] = random_key();
 		}
-		return 1;
-	} else if (dj == 0) { /* like rook, horizontally */
-		for (int i = MIN(ifrom, ito) + 1; i < MAX(ifrom, ito); ++i) {
-			if ((position[i][jfrom] & PIECEMASK) != PIECE_NONE)
-				return 0;
-		}
-		return 1;
 	}
+	for (int k = 0; k < ARRNUM(zobrist_castlerights); ++k)
+		zobrist_castlerights[k] = random_key();
+	for (int i = 0; i < NF; ++i)
+		zobrist_fep[i] = random_key();
+	zobrist_black = random_key();
+	initialized = 1;
+}
+static void init_psq_scores(void)
+{
+	static int initialized;
+	if (initialized)
+		return;
 
-	return 0;
+	for (int p = 0; p < PIECES_NUM; ++p) {
+		int value = p == PIECE_IDX(PIECE_KING) ? 0 : piece_values[p];
+		for (int s = 0; s < SQUARES_NUM; ++s) {
+			/* the tables have the eighth rank first, black mirrors them */
+			int w = s ^ (SQUARES_NUM - NF);
+			int mg = value + psqt[p][w];
+			int eg = value + (p == PIECE_IDX(PIECE_KING) ? psqt_king_endgame[w] : psqt[p][w]);
+			psq_scores[PHASE_MIDDLEGAME][COLOR_WHITE][p][s] = mg;
+			psq_scores[PHASE_ENDGAME][COLOR_WHITE][p][s] = eg;
+
+			mg = value + psqt[p][s];
+			eg = value + (p == PIECE_IDX(PIECE_KING) ? psqt_king_endgame[s] : psqt[p][s]);
+			psq_scores[PHASE_MIDDLEGAME][COLOR_BLACK][p][s] = -mg;
+			psq_scores[PHASE_ENDGAME][COLOR_BLACK][p][s] = -eg;
+		}
+	}
+	initialized = 1;
 }
-static int is_pseudolegal_rook_ply(sqid ifrom, sqid jfrom, sqid ito, sqid jto, int *hints)
+
+/* the en passant field only tells positions apart if a pawn of the
+   active color can take on it */
+static int can_take_en_passant(const game_t *g)
 {
-	color_t c = position[ifrom][jfrom] & COLORMASK;
-	if (((position[ito][jto] & PIECEMASK) != PIECE_NONE)
-			&& (position[ito][jto] & COLORMASK) == c)
+	if (g->fep[0] == -1)
 		return 0;
 
-	if (hints)
-		*hints = 0;
+	color_t c = g->active_color;
+	int s = SQ(g->fep[0], g->fep[1]);
+	return (pawn_attacks[OPP_COLOR(c)][s] & PIECES(PIECE_PAWN) & g->colors[c]) != 0;
+}
+static uint64_t get_fep_key(const game_t *g)
+{
+	return can_take_en_passant(g) ? zobrist_fep[g->fep[0]] : 0;
+}
 
-	if (ito - ifrom == 0) { /* vertically */
-		for (int j = MIN(jfrom, jto) + 1; j < MAX(jfrom, jto); ++j) {
-			if ((position[ifrom][j] & PIECEMASK) != PIECE_NONE)
-				return 0;
-		}
-		return 1;
-	} else if (jto - jfrom == 0) { /* horizontally */
-		for (int i = MIN(ifrom, ito) + 1; i < MAX(ifrom, ito); ++i) {
-			if ((position[i][jfrom] & PIECEMASK) != PIECE_NONE)
-				return 0;
-		}
-		return 1;
-	}
+static void add_psq_score(game_t *g, squareinfo_t info, int s, int sign)
+{
+	color_t c = info & COLORMASK;
+	int p = PIECE_IDX(info & PIECEMASK);
+	g->psq[PHASE_MIDDLEGAME] += sign * psq_scores[PHASE_MIDDLEGAME][c][p][s];
+	g->psq[PHASE_ENDGAME] += sign * psq_scores[PHASE_ENDGAME][c][p][s];
+	g->phase += sign * phase_weights[p];
+	if (p != PIECE_IDX(PIECE_KING))
+		g->material_balance += (c == COLOR_WHITE ? sign : -sign) * piece_values[p];
+}
 
-	return 0;
+static void put_piece(game_t *g, int s, squareinfo_t info)
+{
+	g->mailbox[s] = info;
+	PIECES(info & PIECEMASK) |= BB(s);
+	g->colors[info & COLORMASK] |= BB(s);
+	g->material[info & COLORMASK] += (uint32_t)1 << MATERIAL_SHIFT(info & PIECEMASK, s);
+	g->hash ^= zobrist_pieces[info & COLORMASK][PIECE_IDX(info & PIECEMASK)][s];
+	add_psq_score(g, info, s, 1);
+	if (network && g->netgen == network_generation)
+		nnue_add_piece(network, &g->acc, info, s);
 }
-static int is_pseudolegal_bishop_ply(sqid ifrom, sqid jfrom, sqid ito, sqid jto, int *hints)
+static void remove_piece(game_t *g, int s)
 {
-	color_t c = position[ifrom][jfrom] & COLORMASK;
-	if (((position[ito][jto] & PIECEMASK) != PIECE_NONE)
-			&& (position[ito][jto] & COLORMASK) == c)
+	squareinfo_t info = g->mailbox[s];
+	g->mailbox[s] = PIECE_NONE;
+	PIECES(info & PIECEMASK) &= ~BB(s);
+	g->colors[info & COLORMASK] &= ~BB(s);
+	g->material[info & COLORMASK] -= (uint32_t)1 << MATERIAL_SHIFT(info & PIECEMASK, s);
+	g->hash ^= zobrist_pieces[info & COLORMASK][PIECE_IDX(info & PIECEMASK)][s];
+	add_psq_score(g, info, s, -1);
+	if (network && g->netgen == network_generation)
+		nnue_remove_piece(network, &g->acc, info, s);
+}
+static void move_piece(game_t *g, int from, int to)
+{
+	squareinfo_t info = g->mailbox[from];
+	remove_piece(g, from);
+	put_piece(g, to, info);
+}
+
+static int is_pseudolegal_queen_ply(game_t *g, sqid ifrom, sqid jfrom, sqid ito, sqid jto, int *flags)
+{
+	int from = SQ(ifrom, jfrom);
+	int to = SQ(ito, jto);
+	color_t c = g->mailbox[from] & COLORMASK;
+	if (g->colors[c] & BB(to))
 		return 0;
 
-	if (hints)
-		*hints = 0;
+	if (flags)
+		*flags = 0;
 
-	if (abs(ito - ifrom) != abs(jto - jfrom))
+	bitboard_t occ = OCCUPANCY;
+	return ((bb_rook_attacks(from, occ) | bb_bishop_attacks(from, occ)) & BB(to)) != 0;
+}
+static int is_pseudolegal_rook_ply(game_t *g, sqid ifrom, sqid jfrom, sqid ito, sqid jto, int *flags)
+{
+	int from = SQ(ifrom, jfrom);
+	int to = SQ(ito, jto);
+	color_t c = g->mailbox[from] & COLORMASK;
+	if (g->colors[c] & BB(to))
 		return 0;
 
-	int vi = SGN(ito - ifrom);
-	int vj = SGN(jto - jfrom);
-	for (int k = 1; k < abs(ito - ifrom); ++k) {
-		int i = ifrom + vi * k;
-		int j = jfrom + vj * k;
-		if ((position[i][j] & PIECEMASK) != PIECE_NONE)
-			return 0;
-	}
+	if (flags)
+		*flags = 0;
 
-	return 1;
+	return (bb_rook_attacks(from, OCCUPANCY) & BB(to)) != 0;
 }
-static int is_pseudolegal_knight_ply(sqid ifrom, sqid jfrom, sqid ito, sqid jto, int *hints)
+static int is_pseudolegal_bishop_ply(game_t *g, sqid ifrom, sqid jfrom, sqid ito, sqid jto, int *flags)
 {
-	color_t c = position[ifrom][jfrom] & COLORMASK;
-	if (((position[ito][jto] & PIECEMASK) != PIECE_NONE)
-			&& (position[ito][jto] & COLORMASK) == c)
+	int from = SQ(ifrom, jfrom);
+	int to = SQ(ito, jto);
+	color_t c = g->mailbox[from] & COLORMASK;
+	if (g->colors[c] & BB(to))
 		return 0;
 
-	if (hints)
-		*hints = 0;
-
-	if ((abs(ito - ifrom) + abs(jto - jfrom)) == 3
-			&& ito != ifrom && jto != jfrom)
-		return 1;
+	if (flags)
+		*flags = 0;
 
-	return 0;
+	return (bb_bishop_attacks(from, OCCUPANCY) & BB(to)) != 0;
 }
-static int is_pseudolegal_pawn_ply(sqid ifrom, sqid jfrom, sqid ito, sqid jto, int *hints)
+static int is_pseudolegal_knight_ply(game_t *g, sqid ifrom, sqid jfrom, sqid ito, sqid jto, int *flags)
 {
-	color_t c = position[ifrom][jfrom] & COLORMASK;
-	if (((position[ito][jto] & PIECEMASK) != PIECE_NONE)
-			&& (position[ito][jto] & COLORMASK) == c)
+	int from = SQ(ifrom, jfrom);
+	int to = SQ(ito, jto);
+	color_t c = g->mailbox[from] & COLORMASK;
+	if (g->colors[c] & BB(to))
 		return 0;
 
-	if (hints)
-		*hints = 0;
+	if (flags)
+		*flags = 0;
 
-	int di = ito - ifrom;
-	int dj = jto - jfrom;
+	return (knight_attacks[from] & BB(to)) != 0;
+}
+TEMPLATE int is_pseudolegal_pawn_ply_for(color_t c, game_t *g, int from, int to, int *flags)
+{
+	if (g->colors[c] & BB(to))
+		return 0;
+
+	if (flags)
+		*flags = 0;
 
-	int step = 1 - 2 * c;
-	int promrank = OPP_COLOR(c) * (NF - 1);
-	int pawnrank = c * (NF - 2) + OPP_COLOR(c);
-	if (dj == step && di == 0) { /* normal step */
-		if ((position[ito][jto] & PIECEMASK) == PIECE_NONE) {
-			if (hints && jto == promrank)
-				*hints |= HINT_PROMOTION;
+	bitboard_t occ = OCCUPANCY;
+	int step = PAWN_STEP(c);
+	if (to == from + step) { /* normal step */
+		if (!(occ & BB(to))) {
+			if (flags && SQ_RANK(to) == PROMRANK(c))
+				*flags = MOVE_FLAG_PROMOTION;
 			return 1;
 		}
-	} else if (dj == step && abs(di) == 1) { /* diagonal step with take */
-		if ((position[ito][jto] & PIECEMASK) != PIECE_NONE
-				&& (position[ito][jto] & COLORMASK) != c) {
-			if (hints && jto == promrank)
-				*hints |= HINT_PROMOTION;
+	} else if (pawn_attacks[c][from] & BB(to)) { /* diagonal step with take */
+		if (g->colors[OPP_COLOR(c)] & BB(to)) {
+			if (flags && SQ_RANK(to) == PROMRANK(c))
+				*flags = MOVE_FLAG_PROMOTION;
 			return 1;
-		} else if (ito == fep[0] && jto == fep[1]) {
-			if (hints)
-				*hints |= HINT_EN_PASSANT;
+		} else if (g->fep[0] != -1 && to == SQ(g->fep[0], g->fep[1])) {
+			if (flags)
+				*flags = MOVE_FLAG_EN_PASSANT;
 			return 1;
 		}
-	} else if (jfrom == pawnrank && dj == 2 * step && di == 0) { /* 2 square step from pawnrank */
-		if ((position[ito][jto - step] & PIECEMASK) == PIECE_NONE
-				&& (position[ito][jto] & PIECEMASK) == PIECE_NONE) {
-			if (hints)
-				*hints |= HINT_SET_EN_PASSANT_FIELD;
+	} else if (SQ_RANK(from) == PAWNRANK(c) && to == from + 2 * step) { /* 2 square step from pawnrank */
+		if (!(occ & (BB(to) | BB(from + step))))
 			return 1;
-		}
 	}
 
 	return 0;
 }
-static int is_pseudolegal_non_king_ply(piece_t piece, sqid ifrom, sqid jfrom,
+static int is_pseudolegal_pawn_ply(game_t *g, sqid ifrom, sqid jfrom, sqid ito, sqid jto, int *flags)
+{
+	int from = SQ(ifrom, jfrom);
+	int to = SQ(ito, jto);
+	color_t c = g->mailbox[from] & COLORMASK;
+	return BY_COLOR(c, is_pseudolegal_pawn_ply_for, g, from, to, flags);
+}
+static int is_pseudolegal_non_king_ply(game_t *g, piece_t piece, sqid ifrom, sqid jfrom,
 		sqid ito, sqid jto, int *flags)
 {
 	switch (piece) {
 	case PIECE_QUEEN:
-		return is_pseudolegal_queen_ply(ifrom, jfrom, ito, jto, flags);
+		return is_pseudolegal_queen_ply(g, ifrom, jfrom, ito, jto, flags);
 	case PIECE_ROOK:
-		return is_pseudolegal_rook_ply(ifrom, jfrom, ito, jto, flags);
+		return is_pseudolegal_rook_ply(g, ifrom, jfrom, ito, jto, flags);
 	case PIECE_BISHOP:
-		return is_pseudolegal_bishop_ply(ifrom, jfrom, ito, jto, flags);
+		return is_pseudolegal_bishop_ply(g, ifrom, jfrom, ito, jto, flags);
 	case PIECE_KNIGHT:
-		return is_pseudolegal_knight_ply(ifrom, jfrom, ito, jto, flags);
+		return is_pseudolegal_knight_ply(g, ifrom, jfrom, ito, jto, flags);
 	case PIECE_PAWN:
-		return is_pseudolegal_pawn_ply(ifrom, jfrom, ito, jto, flags);
+		return is_pseudolegal_pawn_ply(g, ifrom, jfrom, ito, jto, flags);
 	default:
 		assert(0);
 	}
 }
 
-static void get_king(color_t c, sqid *i, sqid *j)
+/* pieces of the opponent of c attacking square s, given the boards
+   pieces and colors and the occupancy occ */
+TEMPLATE bitboard_t get_board_attackers(const bitboard_t *pieces, const bitboard_t *colors,
+		color_t c, int s, bitboard_t occ)
 {
-	for (sqid l = 0; l < NF; ++l) {
-		for (sqid k = 0; k < NF; ++k) {
-			if ((position[k][l] & PIECEMASK) == PIECE_KING
-					&& (position[k][l] & COLORMASK) == c) {
-				*i = k;
-				*j = l;
-				return;
-			}
-		}
-	}
+	bitboard_t queens = pieces[PIECE_IDX(PIECE_QUEEN)];
+	bitboard_t b = (pawn_attacks[c][s] & pieces[PIECE_IDX(PIECE_PAWN)])
+		| (knight_attacks[s] & pieces[PIECE_IDX(PIECE_KNIGHT)])
+		| (king_attacks[s] & pieces[PIECE_IDX(PIECE_KING)])
+		| (bb_bishop_attacks(s, occ) & (pieces[PIECE_IDX(PIECE_BISHOP)] | queens))
+		| (bb_rook_attacks(s, occ) & (pieces[PIECE_IDX(PIECE_ROOK)] | queens));
+	return b & colors[OPP_COLOR(c)];
 }
-static int is_square_non_king_attacked(color_t c, sqid i, sqid j)
+static bitboard_t get_attackers(game_t *g, color_t c, int s, bitboard_t occ)
 {
-	for (sqid l = 0; l < NF; ++l) {
-		for (sqid k = 0; k < NF; ++k) {
-			if ((position[k][l] & PIECEMASK) == PIECE_NONE
-					|| (position[k][l] & PIECEMASK) == PIECE_KING
-					|| (position[k][l] & COLORMASK) == c)
-				continue;
-
-			piece_t p = position[k][l] & PIECEMASK;
-			if (is_pseudolegal_non_king_ply(p, k, l, i, j, NULL))
-				return 1;
-		}
-	}
-	return 0;
+	return get_board_attackers(g->pieces, g->colors, c, s, occ);
+}
+static int is_square_attacked(game_t *g, color_t c, int s)
+{
+	return get_attackers(g, c, s, OCCUPANCY) != 0;
 }
-static int is_pseudolegal_king_ply(sqid ifrom, sqid jfrom, sqid ito, sqid jto, int *hints)
+static int is_in_check(game_t *g, color_t c)
 {
-	color_t c = position[ifrom][jfrom] & COLORMASK;
-	if (((position[ito][jto] & PIECEMASK) != PIECE_NONE)
-			&& (position[ito][jto] & COLORMASK) == c)
+	return is_square_attacked(g, c, g->kingsq[c]);
+}
+TEMPLATE int is_pseudolegal_king_ply_for(color_t c, game_t *g, int from, int to, int *flags)
+{
+	if (g->colors[c] & BB(to))
 		return 0;
 
-	if (hints) {
-		*hints = 0;
-		if (castlerights[c] & CASTLERIGHT_KINGSIDE)
-			*hints |= HINT_DEL_CASTLERIGHT_KINGSIDE;
-		if (castlerights[c] & CASTLERIGHT_QUEENSIDE)
-			*hints |= HINT_DEL_CASTLERIGHT_QUEENSIDE;
-	}
+	if (flags)
+		*flags = 0;
 
-	if (abs(ito - ifrom) <= 1 && abs(jto - jfrom) <= 1) { /* normal ply */
+	bitboard_t occ = OCCUPANCY;
+	int backrank = BACKRANK(c);
+	if (king_attacks[from] & BB(to)) { /* normal ply */
 		return 1;
-	} else if (ito == NF - 2 && (jto == 0 || jto == NF - 1)
-			&& (castlerights[c] & CASTLERIGHT_KINGSIDE)) { /* kingside castle */
-		if ((position[NF - 2][jto] & PIECEMASK) != PIECE_NONE
-				|| (position[NF - 3][jto] & PIECEMASK) != PIECE_NONE)
+	} else if (to == SQ(NF - 2, backrank) && SQ_RANK(from) == backrank
+			&& (g->castlerights[c] & CASTLERIGHT_KINGSIDE)) { /* kingside castle */
+		if (occ & (BB(SQ(NF - 2, backrank)) | BB(SQ(NF - 3, backrank))))
 			return 0;
 
-		if (is_square_non_king_attacked(c, NF - 4, jto)
-				|| is_square_non_king_attacked(c, NF - 3, jto))
+		if (is_square_attacked(g, c, SQ(NF - 4, backrank))
+				|| is_square_attacked(g, c, SQ(NF - 3, backrank)))
 			return 0;
 
-		if (hints)
-			*hints |= HINT_CASTLE;
+		if (flags)
+			*flags = MOVE_FLAG_CASTLE;
 		return 1;
-	} else if (ito == 2 && (jto == 0 || jto == NF - 1)
-			&& (castlerights[c] & CASTLERIGHT_QUEENSIDE)) { /* queenside castle */
-		if ((position[1][jto] & PIECEMASK) != PIECE_NONE
-				|| (position[2][jto] & PIECEMASK) != PIECE_NONE
-				|| (position[3][jto] & PIECEMASK) != PIECE_NONE)
+	} else if (to == SQ(2, backrank) && SQ_RANK(from) == backrank
+			&& (g->castlerights[c] & CASTLERIGHT_QUEENSIDE)) { /* queenside castle */
+		if (occ & (BB(SQ(1, backrank)) | BB(SQ(2, backrank)) | BB(SQ(3, backrank))))
 			return 0;
 
-		if (is_square_non_king_attacked(c, 3, jto)
-				|| is_square_non_king_attacked(c, 4, jto))
+		if (is_square_attacked(g, c, SQ(3, backrank))
+				|| is_square_attacked(g, c, SQ(4, backrank)))
 			return 0;
 
-		if (hints)
-			*hints |= HINT_CASTLE;
+		if (flags)
+			*flags = MOVE_FLAG_CASTLE;
 		return 1;
 	}
 
 	return 0;
 }
-static int is_pseudolegal_ply(piece_t piece, sqid ifrom, sqid jfrom, sqid ito, sqid jto, int *flags)
+static int is_pseudolegal_king_ply(game_t *g, sqid ifrom, sqid jfrom, sqid ito, sqid jto, int *flags)
+{
+	int from = SQ(ifrom, jfrom);
+	int to = SQ(ito, jto);
+	color_t c = g->mailbox[from] & COLORMASK;
+	return BY_COLOR(c, is_pseudolegal_king_ply_for, g, from, to, flags);
+}
+static int is_pseudolegal_ply(game_t *g, piece_t piece, sqid ifrom, sqid jfrom,
+		sqid ito, sqid jto, int *flags)
 {
 	if (piece == PIECE_KING) {
-		return is_pseudolegal_king_ply(ifrom, jfrom, ito, jto, flags);
+		return is_pseudolegal_king_ply(g, ifrom, jfrom, ito, jto, flags);
 	} else {
-		return is_pseudolegal_non_king_ply(piece, ifrom, jfrom, ito, jto, flags);
+		return is_pseudolegal_non_king_ply(g, piece, ifrom, jfrom, ito, jto, flags);
 	}
 }
 
-static int exec_ply(sqid ifrom, sqid jfrom, sqid ito, sqid jto, int hints, piece_t prompiece)
+/* make sure that n ply records are free, the stack is doubled to keep
+   the number of reallocations logarithmic */
+static int reserve_plies(game_t *g, unsigned int n)
 {
-	color_t c = position[ifrom][jfrom] & COLORMASK;
-
-	ply_t ply;
-	memset(&ply, 0, sizeof(ply));
-	ply.p = position[ifrom][jfrom] & PIECEMASK;
-	ply.from[0] = ifrom;
-	ply.from[1] = jfrom;
-	ply.to[0] = ito;
-	ply.to[1] = jto;
-	ply.taken = position[ito][jto] & PIECEMASK;
-	ply.prompiece = prompiece;
-	memcpy(ply.fep, fep, sizeof(fep));
-	memcpy(ply.castlerights, castlerights, sizeof(ply.castlerights));
-	memcpy(ply.position, position, sizeof(ply.position));
-	ply.ndrawplies = drawish_plies_num;
-	ply.nmove = nmove;
-	ply.hints = hints;
+	if (g->pliessize - g->pliesnum >= n)
+		return 0;
 
-	fep[0] = -1;
-	fep[1] = -1;
+	unsigned int size = MAX(2 * g->pliessize, g->pliesnum + PLIES_RESERVE);
+	ply_t *p = realloc(g->plies, size * sizeof(*p));
+	if (!p)
+		return -1;
+	g->plies = p;
+	g->pliessize = size;
+	++g->nallocs;
+	return 0;
+}
+TEMPLATE void exec_ply_for(color_t c, game_t *g, move_t m)
+{
+	int from = MOVE_FROM(m);
+	int to = MOVE_TO(m);
+	int backrank = BACKRANK(c);
+
+	assert(g->pliesnum < g->pliessize);
+	ply_t *ply = &g->plies[g->pliesnum];
+	ply->hash = g->hash;
+	ply->ndrawplies = g->drawish_plies_num;
+	ply->move = m;
+	ply->p = g->mailbox[from] & PIECEMASK;
+	ply->taken = g->mailbox[to] & PIECEMASK;
+	ply->castlerights = PACK_CASTLERIGHTS(g->castlerights);
+	ply->fep = g->fep[0] == -1 ? -1 : SQ(g->fep[0], g->fep[1]);
+	ply->status = STATUS_UNKNOWN;
+	++g->pliesnum;
+
+	g->hash ^= zobrist_castlerights[ply->castlerights];
+	g->hash ^= get_fep_key(g);
+	g->fep[0] = -1;
+	g->fep[1] = -1;
 
 	/* apply bare ply */
-	position[ito][jto] = position[ifrom][jfrom];
-	position[ifrom][jfrom] = PIECE_NONE;
-
-	/* apply hints */
-	if (hints & HINT_CASTLE) {
-		if (ito > ifrom) {
-			position[NF - 3][jfrom] = position[NF - 1][jfrom];
-			position[NF - 1][jfrom] = PIECE_NONE;
+	if (ply->taken != PIECE_NONE)
+		remove_piece(g, to);
+	move_piece(g, from, to);
+
+	/* apply flags */
+	switch (MOVE_FLAGS(m)) {
+	case MOVE_FLAG_CASTLE:
+		if (to > from) {
+			move_piece(g, SQ(NF - 1, backrank), SQ(NF - 3, backrank));
 		} else {
-			position[3][jfrom] = position[0][jfrom];
-			position[0][jfrom] = PIECE_NONE;
+			move_piece(g, SQ(0, backrank), SQ(3, backrank));
 		}
-	} else if (hints & HINT_EN_PASSANT) {
-		ply.taken = position[ito][jfrom] & PIECEMASK;
-
-		position[ito][jfrom] = PIECE_NONE;
-	} else if (hints & HINT_SET_EN_PASSANT_FIELD) {
-		fep[0] = ifrom;
-		fep[1] = (jfrom + jto) / 2;
-	} else if (hints & HINT_PROMOTION) {
-		position[ito][jto] = (position[ito][jto] & COLORMASK) | prompiece;
-	}
-
-	/* remove castle rights */
-	if (hints & HINT_DEL_CASTLERIGHT_QUEENSIDE)
-		castlerights[c] &= ~CASTLERIGHT_QUEENSIDE;
-	if (hints & HINT_DEL_CASTLERIGHT_KINGSIDE)
-		castlerights[c] &= ~CASTLERIGHT_KINGSIDE;
-
-	int oc = OPP_COLOR(c);
-	int backrank = oc * (NF - 1);
-	if (castlerights[oc] & CASTLERIGHT_QUEENSIDE
-			&& (position[0][backrank] & PIECEMASK) != PIECE_ROOK)
-		castlerights[oc] &= ~CASTLERIGHT_QUEENSIDE;
-	if (castlerights[oc] & CASTLERIGHT_KINGSIDE
-			&& (position[NF - 1][backrank] & PIECEMASK) != PIECE_ROOK)
-		castlerights[oc] &= ~CASTLERIGHT_KINGSIDE;
+		break;
+	case MOVE_FLAG_EN_PASSANT:
+		ply->taken = g->mailbox[to - PAWN_STEP(c)] & PIECEMASK;
+
+		remove_piece(g, to - PAWN_STEP(c));
+		break;
+	case MOVE_FLAG_PROMOTION:
+		remove_piece(g, to);
+		put_piece(g, to, c | MOVE_PROMPIECE(m));
+		break;
+	}
+
+	/* a double step opens the en passant field, a king move loses the
+	   castle rights */
+	if (ply->p == PIECE_PAWN && to - from == 2 * PAWN_STEP(c)) {
+		g->fep[0] = SQ_FILE(from);
+		g->fep[1] = SQ_RANK(from + PAWN_STEP(c));
+	} else if (ply->p == PIECE_KING) {
+		g->kingsq[c] = to;
+		g->castlerights[c] = 0;
+	}
+
+	for (color_t cc = COLOR_WHITE; cc <= COLOR_BLACK; ++cc) {
+		int backrank = cc * (NF - 1);
+		bitboard_t rooks = PIECES(PIECE_ROOK) & g->colors[cc];
+		if (g->castlerights[cc] & CASTLERIGHT_QUEENSIDE
+				&& !(rooks & BB(SQ(0, backrank))))
+			g->castlerights[cc] &= ~CASTLERIGHT_QUEENSIDE;
+		if (g->castlerights[cc] & CASTLERIGHT_KINGSIDE
+				&& !(rooks & BB(SQ(NF - 1, backrank))))
+			g->castlerights[cc] &= ~CASTLERIGHT_KINGSIDE;
+	}
+	g->hash ^= zobrist_castlerights[PACK_CASTLERIGHTS(g->castlerights)];
 
 	/* count drawish plies for fifty-move rule */
-	if ((ply.taken & PIECEMASK) == PIECE_NONE && ply.p != PIECE_PAWN) {
-		++drawish_plies_num;
+	if (ply->taken == PIECE_NONE && ply->p != PIECE_PAWN) {
+		++g->drawish_plies_num;
 	} else {
-		drawish_plies_num = 0;
+		g->drawish_plies_num = 0;
 	}
 
 	/* update fullmove number */
-	if (active_color == COLOR_BLACK)
-		++nmove;
+	if (g->active_color == COLOR_BLACK)
+		++g->nmove;
 
 	/* update active color */
-	active_color = OPP_COLOR(active_color);
-
-	/* add ply to list */
-	if (pliesnum == pliessize) {
-		pliessize += PLIES_BUFSIZE;
-		ply_t *p = realloc(plies, pliessize * sizeof(*p));
-		if (!p)
-			return -1;
-		plies = p;
-	}
-	plies[pliesnum] = ply;
-	++pliesnum;
-	return 0;
+	g->active_color = OPP_COLOR(g->active_color);
+	g->hash ^= zobrist_black;
+	g->hash ^= get_fep_key(g);
 }
-static void undo_last_ply()
+static void exec_ply(game_t *g, move_t m)
+{
+	BY_COLOR(g->active_color, exec_ply_for, g, m);
+}
+TEMPLATE void undo_last_ply_for(color_t c, game_t *g)
 {
-	assert(pliesnum > 0);
-
-	ply_t ply = plies[pliesnum - 1];
-	sqid ifrom = ply.from[0];
-	sqid jfrom = ply.from[1];
-	sqid ito = ply.to[0];
-	sqid jto = ply.to[1];
-	color_t c = position[ito][jto] & COLORMASK;
-
-	memcpy(fep, ply.fep, sizeof(fep));
-
 	/* remove ply from list */
-	--pliesnum;
-
-	/* restore active color, fullmove number, drawish plies and castlerights */
-	active_color = OPP_COLOR(active_color);
-	nmove = ply.nmove;
-	drawish_plies_num = ply.ndrawplies;
-	memcpy(castlerights, ply.castlerights, sizeof(castlerights));
-
-	/* undo hints */
-	if (ply.hints & HINT_CASTLE) {
-		if (ito > ifrom) {
-			position[NF - 1][jfrom] = position[NF - 3][jfrom];
-			position[NF - 3][jfrom] = PIECE_NONE;
+	--g->pliesnum;
+
+	const ply_t *ply = &g->plies[g->pliesnum];
+	int from = MOVE_FROM(ply->move);
+	int to = MOVE_TO(ply->move);
+	int flags = MOVE_FLAGS(ply->move);
+	int backrank = BACKRANK(c);
+
+	/* restore active color, fullmove number, drawish plies, castlerights
+	   and en passant field */
+	g->active_color = OPP_COLOR(g->active_color);
+	if (g->active_color == COLOR_BLACK)
+		--g->nmove;
+	g->drawish_plies_num = ply->ndrawplies;
+	UNPACK_CASTLERIGHTS(ply->castlerights, g->castlerights);
+	g->fep[0] = ply->fep == -1 ? -1 : SQ_FILE(ply->fep);
+	g->fep[1] = ply->fep == -1 ? -1 : SQ_RANK(ply->fep);
+
+	/* undo flags */
+	if (flags == MOVE_FLAG_CASTLE) {
+		if (to > from) {
+			move_piece(g, SQ(NF - 3, backrank), SQ(NF - 1, backrank));
 		} else {
-			position[0][jfrom] = position[3][jfrom];
-			position[3][jfrom] = PIECE_NONE;
+			move_piece(g, SQ(3, backrank), SQ(0, backrank));
 		}
-	} else if (ply.hints & HINT_EN_PASSANT) {
-		position[ito][jfrom] = ply.taken | OPP_COLOR(active_color);
-	} else if (ply.hints & HINT_PROMOTION) {
-		position[ito][jto] = (position[ito][jto] & COLORMASK) | PIECE_PAWN;
+	} else if (flags == MOVE_FLAG_PROMOTION) {
+		remove_piece(g, to);
+		put_piece(g, to, c | PIECE_PAWN);
 	}
 
 	/* undo bare ply */
-	position[ifrom][jfrom] = position[ito][jto];
+	move_piece(g, to, from);
+	if (ply->p == PIECE_KING)
+		g->kingsq[c] = from;
+
+	if (flags == MOVE_FLAG_EN_PASSANT) {
+		put_piece(g, to - PAWN_STEP(c), ply->taken | OPP_COLOR(c));
+	} else if (ply->taken != PIECE_NONE) {
+		put_piece(g, to, ply->taken | OPP_COLOR(c));
+	}
 
-	position[ito][jto] = (ply.hints & HINT_EN_PASSANT) ?
-		PIECE_NONE : (ply.taken | OPP_COLOR(active_color));
+	g->hash = ply->hash;
+}
+static void undo_last_ply(game_t *g)
+{
+	assert(g->pliesnum > 0);
+	BY_COLOR(OPP_COLOR(g->active_color), undo_last_ply_for, g);
 }
 
-static int piece_has_legal_ply(sqid ipiece, sqid jpiece)
+/* checkers and pins of the active color, computed once per position so
+   that the legality of a pseudolegal ply can be read off directly */
+static void update_checkinfo(game_t *g)
 {
-	piece_t p = position[ipiece][jpiece] & PIECEMASK;
-	color_t c = position[ipiece][jpiece] & COLORMASK;
-	sqid iking, jking;
-	if (p != PIECE_KING)
-		get_king(c, &iking, &jking);
-	for (int j = 0; j < NF; ++j) {
-		for (int i = 0; i < NF; ++i) {
-			if (i == ipiece && j == jpiece)
-				continue;
+	color_t c = g->active_color;
+	int k = g->kingsq[c];
+	bitboard_t own = g->colors[c];
+	bitboard_t opp = g->colors[OPP_COLOR(c)];
+	bitboard_t occ = OCCUPANCY;
+	bitboard_t queens = PIECES(PIECE_QUEEN);
+
+	g->checkers = get_attackers(g, c, k, occ);
+	if (!g->checkers) {
+		g->checkmask = ~(bitboard_t)0;
+	} else if (!(g->checkers & (g->checkers - 1))) {
+		g->checkmask = g->checkers | squares_between[k][BB_LSB(g->checkers)];
+	} else {
+		g->checkmask = 0;
+	}
 
-			int hints;
-			if (!is_pseudolegal_ply(p, ipiece, jpiece, i, j, &hints))
-				continue;
+	/* sliders that would attack the king if only own pieces were removed */
+	bitboard_t snipers = ((bb_rook_attacks(k, opp) & (PIECES(PIECE_ROOK) | queens))
+		| (bb_bishop_attacks(k, opp) & (PIECES(PIECE_BISHOP) | queens))) & opp;
+	g->pinned = 0;
+	for (; snipers; snipers &= snipers - 1) {
+		bitboard_t b = squares_between[k][BB_LSB(snipers)] & occ;
+		if (!(b & (b - 1)) && (b & own))
+			g->pinned |= b;
+	}
+}
+/* expects update_checkinfo(g) to be called for the current position */
+static int is_legal_ply(game_t *g, move_t m)
+{
+	int from = MOVE_FROM(m);
+	int to = MOVE_TO(m);
+	color_t c = g->active_color;
+	int k = g->kingsq[c];
+
+	if (from == k) {
+		/* the king must not shadow the square behind it from sliders */
+		if (MOVE_FLAGS(m) == MOVE_FLAG_CASTLE)
+			return !is_square_attacked(g, c, to);
+		return !get_attackers(g, c, to, OCCUPANCY ^ BB(from));
+	}
 
-			ply_t m;
-			exec_ply(ipiece, jpiece, i, j, hints, 0);
+	/* taking en passant removes two pieces from a rank or diagonal of the
+	   king at once, which the pin mask can't describe */
+	if (MOVE_FLAGS(m) == MOVE_FLAG_EN_PASSANT) {
+		exec_ply(g, m);
+		int check = is_in_check(g, c);
+		undo_last_ply(g);
+		return !check;
+	}
 
-			int check;
-			if (p == PIECE_KING) {
-				check = is_square_non_king_attacked(c, i, j);
-			} else {
-				check = is_square_non_king_attacked(c, iking, jking);
-			}
+	if (!(g->checkmask & BB(to)))
+		return 0;
+	return !(g->pinned & BB(from)) || (squares_line[k][from] & BB(to));
+}
+
+/* count earlier occurences of the current position, which can only lie
+   within the drawish plies and have the same color to move */
+static int count_repetitions(game_t *g)
+{
+	int n = 0;
+	int first = MAX((int)g->pliesnum - (int)g->drawish_plies_num, 0);
+	for (int k = (int)g->pliesnum - 2; k >= first; k -= 2) {
+		if (g->plies[k].hash == g->hash)
+			++n;
+	}
+	return n;
+}
 
-			undo_last_ply();
-			if (!check)
-				return 1;
+static int add_move(move_t *moves, int n, move_t m)
+{
+	moves[n] = m;
+	return n + 1;
+}
+TEMPLATE int add_pawn_moves_for(color_t c, move_t *moves, int n, int from, bitboard_t targets)
+{
+	bitboard_t promrank = BB_RANK(PROMRANK(c));
+	for (; targets; targets &= targets - 1) {
+		int to = BB_LSB(targets);
+		if (!(BB(to) & promrank)) {
+			n = add_move(moves, n, MOVE(from, to));
+			continue;
 		}
+
+		for (int p = PIECE_IDX(PIECE_QUEEN); p <= PIECE_IDX(PIECE_KNIGHT); ++p)
+			n = add_move(moves, n, MOVE_PROMOTION(from, to, PIECE_BY_IDX(p)));
 	}
-	return 0;
+	return n;
 }
-static int has_legal_ply(color_t color)
+TEMPLATE int generate_pawn_moves_for(color_t c, game_t *g, move_t *moves, int n)
 {
-	for (sqid j = 0; j < NF; ++j) {
-		for (sqid i = 0; i < NF; ++i) {
-			if ((position[i][j] & PIECEMASK) == PIECE_NONE
-					|| (position[i][j] & COLORMASK) != color)
-				continue;
-			if (piece_has_legal_ply(i, j))
-				return 1;
+	int k = g->kingsq[c];
+	bitboard_t occ = OCCUPANCY;
+	bitboard_t opp = g->colors[OPP_COLOR(c)];
+	int step = PAWN_STEP(c);
+	bitboard_t pawnrank = BB_RANK(PAWNRANK(c));
+
+	for (bitboard_t b = PIECES(PIECE_PAWN) & g->colors[c]; b; b &= b - 1) {
+		int from = BB_LSB(b);
+		bitboard_t legal = g->checkmask;
+		if (g->pinned & BB(from))
+			legal &= squares_line[k][from];
+
+		n = add_pawn_moves_for(c, moves, n, from, pawn_attacks[c][from] & opp & legal);
+
+		if (occ & BB(from + step))
+			continue;
+		n = add_pawn_moves_for(c, moves, n, from, BB(from + step) & legal);
+
+		if ((BB(from) & pawnrank) && !(occ & BB(from + 2 * step))
+				&& (legal & BB(from + 2 * step)))
+			n = add_move(moves, n, MOVE(from, from + 2 * step));
+	}
+
+	if (g->fep[0] != -1) {
+		int to = SQ(g->fep[0], g->fep[1]);
+		bitboard_t b = pawn_attacks[OPP_COLOR(c)][to] & PIECES(PIECE_PAWN) & g->colors[c];
+		for (; b; b &= b - 1) {
+			move_t m = MOVE(BB_LSB(b), to) | MOVE_FLAG_EN_PASSANT;
+			if (is_legal_ply(g, m))
+				n = add_move(moves, n, m);
 		}
 	}
-	return 0;
+	return n;
+}
+static int generate_pawn_moves(game_t *g, move_t *moves, int n)
+{
+	return BY_COLOR(g->active_color, generate_pawn_moves_for, g, moves, n);
+}
+static int add_piece_moves(game_t *g, move_t *moves, int n, int from, bitboard_t targets)
+{
+	if (g->pinned & BB(from))
+		targets &= squares_line[g->kingsq[g->active_color]][from];
+	for (targets &= g->checkmask; targets; targets &= targets - 1)
+		n = add_move(moves, n, MOVE(from, BB_LSB(targets)));
+	return n;
+}
+static int generate_piece_moves(game_t *g, move_t *moves, int n)
+{
+	color_t c = g->active_color;
+	bitboard_t occ = OCCUPANCY;
+	bitboard_t own = g->colors[c];
+	bitboard_t queens = PIECES(PIECE_QUEEN);
+
+	/* queens are visited twice, once for each direction type; pinned
+	   knights can never move */
+	for (bitboard_t b = PIECES(PIECE_KNIGHT) & own & ~g->pinned; b; b &= b - 1) {
+		int from = BB_LSB(b);
+		n = add_piece_moves(g, moves, n, from, knight_attacks[from] & ~own);
+	}
+	for (bitboard_t b = (PIECES(PIECE_BISHOP) | queens) & own; b; b &= b - 1) {
+		int from = BB_LSB(b);
+		n = add_piece_moves(g, moves, n, from, bb_bishop_attacks(from, occ) & ~own);
+	}
+	for (bitboard_t b = (PIECES(PIECE_ROOK) | queens) & own; b; b &= b - 1) {
+		int from = BB_LSB(b);
+		n = add_piece_moves(g, moves, n, from, bb_rook_attacks(from, occ) & ~own);
+	}
+	return n;
 }
+TEMPLATE int generate_king_moves_for(color_t c, game_t *g, move_t *moves, int n)
+{
+	bitboard_t own = g->colors[c];
+	int from = g->kingsq[c];
 
-int game_init(const char *fen)
+	for (bitboard_t b = king_attacks[from] & ~own; b; b &= b - 1) {
+		move_t m = MOVE(from, BB_LSB(b));
+		if (is_legal_ply(g, m))
+			n = add_move(moves, n, m);
+	}
+
+	if (g->checkers)
+		return n;
+
+	move_t kingside = MOVE(from, SQ(NF - 2, BACKRANK(c))) | MOVE_FLAG_CASTLE;
+	move_t queenside = MOVE(from, SQ(2, BACKRANK(c))) | MOVE_FLAG_CASTLE;
+	if ((g->castlerights[c] & CASTLERIGHT_KINGSIDE)
+			&& is_pseudolegal_king_ply_for(c, g, from, MOVE_TO(kingside), NULL)
+			&& is_legal_ply(g, kingside))
+		n = add_move(moves, n, kingside);
+	if ((g->castlerights[c] & CASTLERIGHT_QUEENSIDE)
+			&& is_pseudolegal_king_ply_for(c, g, from, MOVE_TO(queenside), NULL)
+			&& is_legal_ply(g, queenside))
+		n = add_move(moves, n, queenside);
+	return n;
+}
+static int generate_king_moves(game_t *g, move_t *moves, int n)
+{
+	return BY_COLOR(g->active_color, generate_king_moves_for, g, moves, n);
+}
+static int generate_legal_moves(game_t *g, move_t *moves)
 {
-	int err = game_load_fen(fen);
-	assert(!err);
+	update_checkinfo(g);
 
-	pliessize = PLIES_BUFSIZE;
-	plies = malloc(pliessize * sizeof(*plies));
-	if (!plies)
-		return -1;
-	return 0;
+	/* in double check only the king can move */
+	int n = 0;
+	if (!(g->checkers & (g->checkers - 1))) {
+		n = generate_pawn_moves(g, moves, n);
+		n = generate_piece_moves(g, moves, n);
+	}
+	return generate_king_moves(g, moves, n);
 }
-void game_terminate(void)
+static int has_legal_ply(game_t *g)
 {
-	free(plies);
+	move_t moves[MOVES_MAX];
+	return generate_legal_moves(g, moves) > 0;
 }
 
-int game_exec_ply(sqid ifrom, sqid jfrom, sqid ito, sqid jto, piece_t prompiece)
+/* full status of the current position, ignoring external events like
+   timeouts */
+static status_t compute_status(game_t *g)
 {
-	piece_t piece = position[ifrom][jfrom] & PIECEMASK;
+	/* check- or stalemate? */
+	if (!has_legal_ply(g)) {
+		if (is_in_check(g, g->active_color))
+			return g->active_color ? STATUS_CHECKMATE_BLACK : STATUS_CHECKMATE_WHITE;
+		return STATUS_DRAW_STALEMATE;
+	}
 
-	/* check if ply is pseudolegal */
-	int hints;
-	if (!is_pseudolegal_ply(piece, ifrom, jfrom, ito, jto, &hints))
-		return 1;
+	/* draw by insufficient material? */
+	if (!game_has_sufficient_mating_material_r(g, COLOR_WHITE)
+			&& !game_has_sufficient_mating_material_r(g, COLOR_BLACK))
+		return STATUS_DRAW_MATERIAL;
+
+	/* draw by repetition? */
+	/* TODO: Adapt to official rules */
+	if (count_repetitions(g) >= 2)
+		return STATUS_DRAW_REPETITION;
 
-	/* exec ply */
-	exec_ply(ifrom, jfrom, ito, jto, hints, prompiece);
+	/* draw by fifty move rule? */
+	if (g->drawish_plies_num >= DRAWISH_MOVES_MAX * 2)
+		return STATUS_DRAW_FIFTY_MOVES;
+
+	/* just moving */
+	return g->active_color ? STATUS_MOVING_BLACK : STATUS_MOVING_WHITE;
+}
+/* the status is computed at most once per ply and dropped together
+   with the ply record on undo */
+static status_t get_status(game_t *g)
+{
+	signed char *status = g->pliesnum ? &g->plies[g->pliesnum - 1].status : &g->status;
+	if (*status == STATUS_UNKNOWN)
+		*status = compute_status(g);
+	return *status;
+}
 
-	/* check if ply is legal */
-	sqid iking, jking;
-	get_king(OPP_COLOR(active_color), &iking, &jking);
-	if (is_square_non_king_attacked(OPP_COLOR(active_color), iking, jking)) {
-		undo_last_ply();
+static int init_game(game_t *g, const char *fen)
+{
+	bb_init();
+	mb_init();
+	init_zobrist();
+	init_psq_scores();
+
+	memset(g, 0, sizeof(*g));
+	if (game_load_fen_r(g, fen))
 		return 1;
+
+	return reserve_plies(g, PLIES_RESERVE);
+}
+
+game_t *game_create(const char *fen)
+{
+	game_t *g = aligned_alloc(MAILBOX_ALIGN, sizeof(*g));
+	if (!g)
+		return NULL;
+
+	if (init_game(g, fen)) {
+		free(g->plies);
+		free(g);
+		return NULL;
 	}
+	return g;
+}
+game_t *game_copy(const game_t *g)
+{
+	game_t *copy = aligned_alloc(MAILBOX_ALIGN, sizeof(*copy));
+	if (!copy)
+		return NULL;
+
+	*copy = *g;
+	copy->nallocs = 1;
+	copy->plies = malloc(g->pliessize * sizeof(*g->plies));
+	if (!copy->plies) {
+		free(copy);
+		return NULL;
+	}
+	memcpy(copy->plies, g->plies, g->pliesnum * sizeof(*g->plies));
+	return copy;
+}
+void game_destroy(game_t *g)
+{
+	free(g->plies);
+	free(g);
+}
+
+move_t game_pack_move(const sqid from[2], const sqid to[2], piece_t prompiece)
+{
+	move_t m = MOVE(SQ(from[0], from[1]), SQ(to[0], to[1]));
+	if (prompiece == PIECE_NONE)
+		return m;
+	return MOVE_PROMOTION(SQ(from[0], from[1]), SQ(to[0], to[1]), prompiece);
+}
+void game_unpack_move(move_t m, sqid from[2], sqid to[2], piece_t *prompiece)
+{
+	from[0] = SQ_FILE(MOVE_FROM(m));
+	from[1] = SQ_RANK(MOVE_FROM(m));
+	to[0] = SQ_FILE(MOVE_TO(m));
+	to[1] = SQ_RANK(MOVE_TO(m));
+	if (prompiece)
+		*prompiece = MOVE_PROMPIECE(m);
+}
+
+int game_exec_ply_r(game_t *g, move_t m)
+{
+	int from = MOVE_FROM(m);
+	int to = MOVE_TO(m);
+	piece_t piece = g->mailbox[from] & PIECEMASK;
+
+	/* only pieces of the active color move, the color templates rely
+	   on it */
+	if (!(g->colors[g->active_color] & BB(from)))
+		return 1;
+
+	/* check if ply is pseudolegal */
+	int flags;
+	if (!is_pseudolegal_ply(g, piece, SQ_FILE(from), SQ_RANK(from),
+				SQ_FILE(to), SQ_RANK(to), &flags))
+		return 1;
+
+	/* check if ply is legal, with the flags only the board can tell */
+	move_t legal = MOVE(from, to) | flags;
+	update_checkinfo(g);
+	if (!is_legal_ply(g, legal))
+		return 1;
 
 	/* indicate that prompiece must be given */
-	if ((hints & HINT_PROMOTION) && prompiece == PIECE_NONE) {
-		undo_last_ply();
-		return 2;
+	if (flags == MOVE_FLAG_PROMOTION) {
+		if (MOVE_FLAGS(m) != MOVE_FLAG_PROMOTION)
+			return 2;
+		legal = m;
 	}
 
+	/* exec ply, keeping the reserve free behind the game history */
+	if (reserve_plies(g, PLIES_RESERVE))
+		return -1;
+	exec_ply(g, legal);
 	return 0;
 }
-void game_undo_last_ply(void)
+int game_exec_move_r(game_t *g, move_t m)
+{
+	/* room for the ply and a legality probe after it, this only ever
+	   allocates once a search goes deeper than the reserve */
+	if (reserve_plies(g, 2))
+		return -1;
+	exec_ply(g, m);
+	return 0;
+}
+void game_undo_last_ply_r(game_t *g)
+{
+	undo_last_ply(g);
+}
+int game_generate_legal_moves_r(game_t *g, move_t *moves)
 {
-	undo_last_ply();
+	return generate_legal_moves(g, moves);
 }
 
-color_t game_get_active_color()
+color_t game_get_active_color_r(const game_t *g)
 {
-	return active_color;
+	return g->active_color;
 }
-piece_t game_get_piece(sqid i, sqid j)
+piece_t game_get_piece_r(const game_t *g, sqid i, sqid j)
 {
-	return position[i][j] & PIECEMASK;
+	return g->mailbox[SQ(i, j)] & PIECEMASK;
 }
-color_t game_get_color(sqid i, sqid j)
+color_t game_get_color_r(const game_t *g, sqid i, sqid j)
 {
-	return position[i][j] & COLORMASK;
+	return g->mailbox[SQ(i, j)] & COLORMASK;
 }
-squareinfo_t game_get_squareinfo(sqid i, sqid j)
+squareinfo_t game_get_squareinfo_r(const game_t *g, sqid i, sqid j)
 {
-	return position[i][j];
+	return g->mailbox[SQ(i, j)];
 }
-unsigned int game_get_ply_number(void)
+uint64_t game_get_hash_r(const game_t *g)
 {
-	return pliesnum;
+	return g->hash;
 }
-int game_get_move_number(void)
+unsigned int game_get_ply_number_r(const game_t *g)
 {
-	return pliesnum / 2;
+	return g->pliesnum;
 }
-int game_is_stalemate(void)
+int game_get_move_number_r(const game_t *g)
 {
-	sqid iking, jking;
-	get_king(active_color, &iking, &jking);
-
-	if (is_square_non_king_attacked(active_color, iking, jking))
-		return 0;
-
-	for (sqid j = 0; j < NF; ++j) {
-		for (sqid i = 0; i < NF; ++i) {
-			if ((position[i][j] & PIECEMASK) == PIECE_NONE
-					|| (position[i][j] & COLORMASK) != active_color)
-				continue;
-			if (piece_has_legal_ply(i, j))
-				return 0;
-		}
+	return g->pliesnum / 2;
+}
+unsigned long game_get_allocation_count_r(const game_t *g)
+{
+	return g->nallocs;
+}
+int game_is_stalemate_r(game_t *g)
+{
+	return get_status(g) == STATUS_DRAW_STALEMATE;
+}
+int game_is_checkmate_r(game_t *g)
+{
+	status_t status = get_status(g);
+	return status == STATUS_CHECKMATE_WHITE || status == STATUS_CHECKMATE_BLACK;
+}
+uint64_t game_get_legal_targets_r(game_t *g, sqid i, sqid j)
+{
+	if (!g->targetsvalid || g->targetshash != g->hash) {
+		move_t moves[MOVES_MAX];
+		int n = generate_legal_moves(g, moves);
+		memset(g->targets, 0, sizeof(g->targets));
+		for (int k = 0; k < n; ++k)
+			g->targets[MOVE_FROM(moves[k])] |= BB(MOVE_TO(moves[k]));
+		g->targetshash = g->hash;
+		g->targetsvalid = 1;
 	}
-
-	return 1;
+	return g->targets[SQ(i, j)];
 }
-int game_is_checkmate(void)
+int game_is_movable_piece_at_r(const game_t *g, sqid i, sqid j)
+{
+	return (g->colors[g->active_color] & BB(SQ(i, j))) != 0;
+}
+int game_is_check_r(game_t *g)
+{
+	return is_in_check(g, g->active_color);
+}
+int game_is_repetition_r(game_t *g)
+{
+	return count_repetitions(g) > 0;
+}
+int game_last_ply_was_capture_r(const game_t *g)
 {
-	sqid iking, jking;
-	get_king(active_color, &iking, &jking);
+	return g->plies[g->pliesnum - 1].taken != PIECE_NONE;
+}
 
-	if (!is_square_non_king_attacked(active_color, iking, jking))
-		return 0;
+/* a lone knight or bishops of a single square color can only mate if
+   the opponent has pieces that block the flight squares of its king */
+static int get_material_class(uint32_t material)
+{
+	material &= ~MATERIAL_NIBBLE(PIECE_IDX(PIECE_KING));
+	if (!material)
+		return MATERIAL_BARE;
+	else if (material == (uint32_t)1 << (4 * PIECE_IDX(PIECE_KNIGHT)))
+		return MATERIAL_KNIGHT;
+	else if (!(material & ~MATERIAL_NIBBLE(MATERIAL_LIGHT_BISHOP)))
+		return MATERIAL_LIGHT_BISHOPS;
+	else if (!(material & ~MATERIAL_NIBBLE(PIECE_IDX(PIECE_BISHOP))))
+		return MATERIAL_DARK_BISHOPS;
+	return MATERIAL_OTHER;
+}
+int game_has_sufficient_mating_material_r(const game_t *g, color_t color)
+{
+	int own = get_material_class(g->material[color]);
+	int opp = get_material_class(g->material[OPP_COLOR(color)]);
+	return sufficient_material[own][opp];
+}
+int game_get_piece_count_r(const game_t *g, color_t color, piece_t piece)
+{
+	int n = (g->material[color] >> (4 * PIECE_IDX(piece))) & 0xf;
+	if (piece == PIECE_BISHOP)
+		n += (g->material[color] >> (4 * MATERIAL_LIGHT_BISHOP)) & 0xf;
+	return n;
+}
+int game_get_piece_value(piece_t p)
+{
+	return piece_values[PIECE_IDX(p)];
+}
+int game_see_r(const game_t *g, move_t m)
+{
+	int from = MOVE_FROM(m);
+	int to = MOVE_TO(m);
+	color_t c = g->mailbox[from] & COLORMASK;
+	bitboard_t occ = OCCUPANCY ^ BB(from);
+	bitboard_t bishops = PIECES(PIECE_BISHOP) | PIECES(PIECE_QUEEN);
+	bitboard_t rooks = PIECES(PIECE_ROOK) | PIECES(PIECE_QUEEN);
+
+	/* gain[d] is the balance for the side making capture d, if the
+	   exchange stopped right after it */
+	int gain[32];
+	int d = 0;
+	piece_t onsquare = g->mailbox[from] & PIECEMASK;
+	gain[0] = 0;
+	if (MOVE_FLAGS(m) == MOVE_FLAG_EN_PASSANT) {
+		occ ^= BB(to - PAWN_STEP(c));
+		gain[0] = piece_values[PIECE_IDX(PIECE_PAWN)];
+	} else if ((g->mailbox[to] & PIECEMASK) != PIECE_NONE) {
+		gain[0] = piece_values[PIECE_IDX(g->mailbox[to] & PIECEMASK)];
+	}
+	if (MOVE_FLAGS(m) == MOVE_FLAG_PROMOTION) {
+		onsquare = MOVE_PROMPIECE(m);
+		gain[0] += piece_values[PIECE_IDX(onsquare)] - piece_values[PIECE_IDX(PIECE_PAWN)];
+	}
 
-	for (sqid j = 0; j < NF; ++j) {
-		for (sqid i = 0; i < NF; ++i) {
-			if ((position[i][j] & PIECEMASK) == PIECE_NONE
-					|| (position[i][j] & COLORMASK) != active_color)
-				continue;
-			if (piece_has_legal_ply(i, j))
-				return 0;
-		}
+	bitboard_t attackers = (pawn_attacks[COLOR_BLACK][to] & PIECES(PIECE_PAWN) & g->colors[COLOR_WHITE])
+		| (pawn_attacks[COLOR_WHITE][to] & PIECES(PIECE_PAWN) & g->colors[COLOR_BLACK])
+		| (knight_attacks[to] & PIECES(PIECE_KNIGHT))
+		| (king_attacks[to] & PIECES(PIECE_KING))
+		| (bb_bishop_attacks(to, occ) & bishops)
+		| (bb_rook_attacks(to, occ) & rooks);
+	for (c = OPP_COLOR(c); d < (int)ARRNUM(gain) - 1; c = OPP_COLOR(c)) {
+		bitboard_t own = attackers & occ & g->colors[c];
+		if (!own)
+			break;
+
+		/* always recapture with the least valuable piece */
+		int p = PIECE_IDX(PIECE_PAWN);
+		while (!(own & g->pieces[p]))
+			--p;
+
+		++d;
+		gain[d] = piece_values[PIECE_IDX(onsquare)] - gain[d - 1];
+		onsquare = PIECE_BY_IDX(p);
+
+		/* sliders behind the captured piece join in */
+		occ ^= BB(BB_LSB(own & g->pieces[p]));
+		attackers |= (bb_bishop_attacks(to, occ) & bishops) | (bb_rook_attacks(to, occ) & rooks);
 	}
 
-	return 1;
+	/* every side may also stop instead of recapturing */
+	for (; d > 0; --d)
+		gain[d - 1] = -MAX(-gain[d - 1], gain[d]);
+	return gain[0];
 }
-int game_is_movable_piece_at(sqid i, sqid j)
+int game_get_material_balance_r(const game_t *g)
 {
-	return ((position[i][j] & PIECEMASK) != PIECE_NONE)
-		&& (position[i][j] & COLORMASK) == active_color;
+	return g->material_balance;
 }
-int game_last_ply_was_capture(void)
+int game_get_psq_score_r(const game_t *g)
 {
-	return plies[pliesnum - 1].taken != PIECE_NONE;
+	/* promotions may take the phase beyond the start position */
+	int phase = MIN(g->phase, PHASE_MAX);
+	return (g->psq[PHASE_MIDDLEGAME] * phase
+			+ g->psq[PHASE_ENDGAME] * (PHASE_MAX - phase)) / PHASE_MAX;
 }
+int game_evaluate_r(game_t *g)
+{
+	if (!network) {
+		int score = game_get_psq_score_r(g);
+		return g->active_color == COLOR_WHITE ? score : -score;
+	}
 
-int game_has_sufficient_mating_material(color_t color)
+	if (g->netgen != network_generation) {
+		nnue_refresh(network, &g->acc, g->mailbox);
+		g->netgen = network_generation;
+	}
+	return nnue_evaluate(network, &g->acc, g->active_color);
+}
+/* books give castling as the king taking its own rook and know
+   nothing of the other flags */
+static move_t get_book_move(move_t m)
 {
-	int hasking = 0;
-	int nbishops = 0;
-	int nknights = 0;
-	for (int j = 0; j < NF; ++j) {
-		for (int i = 0; i < NF; ++i) {
-			switch (position[i][j] & PIECEMASK) {
-			case PIECE_KING:
-				hasking = 1;
-				break;
-			case PIECE_QUEEN:
-				return 1;
-			case PIECE_ROOK:
-				return 1;
-			case PIECE_BISHOP:
-				++nbishops;
-			case PIECE_KNIGHT:
-				++nknights;
-			case PIECE_PAWN:
-				return 1;
-			}
+	int from = MOVE_FROM(m);
+	int to = MOVE_TO(m);
+	if (MOVE_FLAGS(m) == MOVE_FLAG_CASTLE)
+		return MOVE(from, SQ_FILE(to) > SQ_FILE(from) ? to + 1 : to - 2);
+	else if (MOVE_FLAGS(m) == MOVE_FLAG_PROMOTION)
+		return m;
+	return MOVE(from, to);
+}
+int game_book_moves_r(game_t *g, move_t *moves, unsigned int *weights)
+{
+	if (!book)
+		return 0;
+
+	struct book_entry_t entries[MOVES_MAX];
+	uint64_t key = book_key(g->mailbox, g->active_color, g->castlerights,
+			can_take_en_passant(g) ? g->fep[0] : -1);
+	int nentries = book_probe(book, key, entries, MOVES_MAX);
+	if (!nentries)
+		return 0;
+
+	/* entries of other positions with the same key or of broken books
+	   match no legal move */
+	move_t legal[MOVES_MAX];
+	int nlegal = game_generate_legal_moves_r(g, legal);
+	unsigned int sorted[MOVES_MAX];
+	int n = 0;
+	for (int k = 0; k < nentries; ++k) {
+		int l = 0;
+		while (l < nlegal && get_book_move(legal[l]) != entries[k].move)
+			++l;
+		if (l == nlegal)
+			continue;
+
+		/* keep the moves sorted by weight */
+		int i = n++;
+		for (; i > 0 && entries[k].weight > sorted[i - 1]; --i) {
+			moves[i] = moves[i - 1];
+			sorted[i] = sorted[i - 1];
 		}
+		moves[i] = legal[l];
+		sorted[i] = entries[k].weight;
 	}
-	assert(hasking);
-
-	if (nbishops + nknights > 1)
-		return 1;
-	return 0;
+	if (weights)
+		memcpy(weights, sorted, n * sizeof(*weights));
+	return n;
 }
-void game_get_status(status_t *externstatus)
+int game_is_same_position_r(const game_t *a, const game_t *b)
+{
+	return mb_equal(a->mailbox, b->mailbox) && a->active_color == b->active_color
+		&& PACK_CASTLERIGHTS(a->castlerights) == PACK_CASTLERIGHTS(b->castlerights)
+		&& get_fep_key(a) == get_fep_key(b);
+}
+void game_get_status_r(game_t *g, status_t *externstatus)
 {
 	/* surrender? */
 	if (*externstatus == STATUS_SURRENDER_WHITE || *externstatus == STATUS_SURRENDER_BLACK)
@@ -670,100 +1349,56 @@ void game_get_status(status_t *externstatus)
 
 	/* timeout? */
 	if (*externstatus == STATUS_TIMEOUT_WHITE) {
-		*externstatus = game_has_sufficient_mating_material(COLOR_BLACK) ?
+		*externstatus = game_has_sufficient_mating_material_r(g, COLOR_BLACK) ?
 			*externstatus : STATUS_DRAW_MATERIAL_VS_TIMEOUT;
 		return;
 	} else if (*externstatus == STATUS_TIMEOUT_BLACK) {
-		*externstatus = game_has_sufficient_mating_material(COLOR_WHITE) ?
+		*externstatus = game_has_sufficient_mating_material_r(g, COLOR_WHITE) ?
 			*externstatus : STATUS_DRAW_MATERIAL_VS_TIMEOUT;
 		return;
 	}
 
 	assert(*externstatus == STATUS_MOVING_WHITE || *externstatus == STATUS_MOVING_BLACK);
-
-	/* check- or stalemate? */
-	if (!has_legal_ply(active_color)) {
-		sqid iking, jking;
-		get_king(active_color, &iking, &jking);
-
-		if (is_square_non_king_attacked(active_color, iking, jking)) {
-			*externstatus = active_color ?
-				STATUS_CHECKMATE_BLACK : STATUS_CHECKMATE_WHITE;
-		} else {
-			*externstatus = STATUS_DRAW_STALEMATE;
-		}
-		return;
-	}
-
-	/* draw by insufficient material? */
-	if (!game_has_sufficient_mating_material(COLOR_WHITE)
-			&& !game_has_sufficient_mating_material(COLOR_BLACK)) {
-		*externstatus = STATUS_DRAW_MATERIAL;
-		return;
-	}
-
-	/* draw by repetition? */
-	/* TODO: Adapt to official rules */
-	/* TODO: maybe optimize: https://www.chessprogramming.org/Repetitions */
-	for (int i = 0; i < pliesnum; ++i) {
-		int n = 0;
-		for (int j = i + 1; j < pliesnum; ++j) {
-			if (memcmp(plies[i].position, plies[j].position,
-						sizeof(plies[i].position)) == 0
-					&& memcmp(plies[i].fep, plies[j].fep,
-						sizeof(plies[i].fep)) == 0
-					&& memcmp(plies[i].castlerights, plies[j].castlerights,
-						sizeof(plies[i].castlerights)) == 0)
-				++n;
-		}
-		if (n >= 2) {
-			*externstatus = STATUS_DRAW_REPETITION;
-			return;
-		}
-	}
-
-	/* draw by fifty move rule? */
-	if (drawish_plies_num >= DRAWISH_MOVES_MAX * 2) {
-		*externstatus = STATUS_DRAW_FIFTY_MOVES;
-		return;
-	}
-
-	/* just moving */
-	*externstatus = active_color ? STATUS_MOVING_BLACK : STATUS_MOVING_WHITE;
+	*externstatus = get_status(g);
 }
-size_t game_get_updates(unsigned int nply, sqid squares[][2], int alsoindirect)
+size_t game_get_updates_r(const game_t *g, unsigned int nply, sqid squares[][2], int alsoindirect)
 {
-	assert(nply < pliesnum);
+	assert(nply < g->pliesnum);
 
 	size_t size = 2 * sizeof(squares[0]);
 	if (alsoindirect)
 		size = 4 * sizeof(squares[0]);
 	memset(squares, 0xff, size);
 
-	ply_t ply = plies[nply];
-	memcpy(squares[0], ply.from, sizeof(squares[0]));
-	memcpy(squares[1], ply.to, sizeof(squares[1]));
+	const ply_t *ply = &g->plies[nply];
+	sqid ifrom = SQ_FILE(MOVE_FROM(ply->move));
+	sqid jfrom = SQ_RANK(MOVE_FROM(ply->move));
+	sqid ito = SQ_FILE(MOVE_TO(ply->move));
+	squares[0][0] = ifrom;
+	squares[0][1] = jfrom;
+	squares[1][0] = ito;
+	squares[1][1] = SQ_RANK(MOVE_TO(ply->move));
 	size_t nupdates = 2;
 
 	if (alsoindirect) {
-		if (ply.hints & HINT_CASTLE) {
-			if (ply.to[0] > ply.from[0]) {
+		if (MOVE_FLAGS(ply->move) == MOVE_FLAG_CASTLE) {
+			if (ito > ifrom) {
 				squares[2][0] = NF - 3;
-				squares[2][1] = ply.from[1];
+				squares[2][1] = jfrom;
 
 				squares[3][0] = NF - 1;
-				squares[3][1] = ply.from[1];
+				squares[3][1] = jfrom;
 			} else {
 				squares[2][0] = 3;
-				squares[2][1] = ply.from[1];
+				squares[2][1] = jfrom;
 
 				squares[3][0] = 0;
-				squares[3][1] = ply.from[1];
+				squares[3][1] = jfrom;
 			}
 			nupdates += 2;
-		} else if (ply.hints & HINT_EN_PASSANT) {
-			squares[2][0] = ply.to[0];
-			squares[2][1] = ply.from[1];
+		} else if (MOVE_FLAGS(ply->move) == MOVE_FLAG_EN_PASSANT) {
+			squares[2][0] = ito;
+			squares[2][1] = jfrom;
 			nupdates += 1;
 		}
 	}
@@ -771,13 +1406,266 @@ size_t game_get_updates(unsigned int nply, sqid squares[][2], int alsoindirect)
 	return nupdates;
 }
 
-int game_load_fen(const char *s)
+int game_load_fen_r(game_t *g, const char *s)
 {
-	if (!parse_fen(s, position, &active_color, castlerights, fep, &drawish_plies_num, &nmove))
+	squareinfo_t position[NF][NF];
+	color_t active_color;
+	int castlerights[COLORS_NUM];
+	sqid fep[2];
+	unsigned int ndrawplies, nmove;
+	if (!parse_fen(s, position, &active_color, castlerights, fep, &ndrawplies, &nmove))
 		return 1;
+
+	/* the position is checked before g is touched, a refused one
+	   leaves the game as it was */
+	uint8_t mailbox[SQUARES_NUM] __attribute__((aligned(MAILBOX_ALIGN)));
+	for (sqid j = 0; j < NF; ++j) {
+		for (sqid i = 0; i < NF; ++i)
+			mailbox[SQ(i, j)] = position[i][j];
+	}
+	for (color_t c = COLOR_WHITE; c <= COLOR_BLACK; ++c) {
+		if (mb_count(mailbox, PIECE_KING | c, PIECEMASK | COLORMASK) != 1)
+			return 1;
+	}
+
+	/* pawns on a back rank would step off the board */
+	for (sqid i = 0; i < NF; ++i) {
+		if ((mailbox[SQ(i, 0)] & PIECEMASK) == PIECE_PAWN
+				|| (mailbox[SQ(i, NF - 1)] & PIECEMASK) == PIECE_PAWN)
+			return 1;
+	}
+
+	/* the side not to move must not be in check, its king could be
+	   taken otherwise */
+	bitboard_t pieces[PIECES_NUM] = {0};
+	bitboard_t colors[COLORS_NUM] = {0};
+	for (int k = 0; k < SQUARES_NUM; ++k) {
+		if ((mailbox[k] & PIECEMASK) == PIECE_NONE)
+			continue;
+		pieces[PIECE_IDX(mailbox[k] & PIECEMASK)] |= BB(k);
+		colors[mailbox[k] & COLORMASK] |= BB(k);
+	}
+	color_t passive = OPP_COLOR(active_color);
+	int ksq = BB_LSB(pieces[PIECE_IDX(PIECE_KING)] & colors[passive]);
+	if (get_board_attackers(pieces, colors, passive, ksq,
+				colors[COLOR_WHITE] | colors[COLOR_BLACK]))
+		return 1;
+
+	/* castle rights and the en passant field are only kept if the
+	   pieces they move are where the plies expect them */
+	for (color_t c = COLOR_WHITE; c <= COLOR_BLACK; ++c) {
+		int backrank = BACKRANK(c);
+		if (mailbox[SQ(4, backrank)] != (PIECE_KING | c))
+			castlerights[c] = 0;
+		if (mailbox[SQ(0, backrank)] != (PIECE_ROOK | c))
+			castlerights[c] &= ~CASTLERIGHT_QUEENSIDE;
+		if (mailbox[SQ(NF - 1, backrank)] != (PIECE_ROOK | c))
+			castlerights[c] &= ~CASTLERIGHT_KINGSIDE;
+	}
+	if (fep[0] != -1) {
+		int s = SQ(fep[0], fep[1]);
+		if (fep[1] != (passive == COLOR_WHITE ? 2 : NF - 3)
+				|| mailbox[s] != PIECE_NONE
+				|| mailbox[s + PAWN_STEP(passive)] != (PIECE_PAWN | passive)) {
+			fep[0] = -1;
+			fep[1] = -1;
+		}
+	}
+
+	g->active_color = active_color;
+	memcpy(g->castlerights, castlerights, sizeof(g->castlerights));
+	memcpy(g->fep, fep, sizeof(g->fep));
+	g->drawish_plies_num = ndrawplies;
+	g->nmove = nmove;
+
+	memset(g->pieces, 0, sizeof(g->pieces));
+	memset(g->colors, 0, sizeof(g->colors));
+	memset(g->mailbox, 0, sizeof(g->mailbox));
+	memset(g->material, 0, sizeof(g->material));
+	memset(g->psq, 0, sizeof(g->psq));
+	g->phase = 0;
+	g->material_balance = 0;
+	g->hash = 0;
+	g->netgen = 0;
+	g->pliesnum = 0;
+	g->status = STATUS_UNKNOWN;
+	for (int k = 0; k < SQUARES_NUM; ++k) {
+		if ((mailbox[k] & PIECEMASK) != PIECE_NONE)
+			put_piece(g, k, mailbox[k]);
+	}
+	for (color_t c = COLOR_WHITE; c <= COLOR_BLACK; ++c)
+		g->kingsq[c] = BB_LSB(mb_find(g->mailbox, PIECE_KING | c, PIECEMASK | COLORMASK));
+	g->hash ^= zobrist_castlerights[PACK_CASTLERIGHTS(g->castlerights)];
+	g->hash ^= get_fep_key(g);
+	if (g->active_color == COLOR_BLACK)
+		g->hash ^= zobrist_black;
 	return 0;
 }
+void game_get_fen_r(const game_t *g, char *s)
+{
+	squareinfo_t position[NF][NF];
+	for (sqid j = 0; j < NF; ++j) {
+		for (sqid i = 0; i < NF; ++i)
+			position[i][j] = g->mailbox[SQ(i, j)];
+	}
+	format_fen(position, g->active_color, g->castlerights, g->fep,
+			g->drawish_plies_num, g->nmove, s);
+}
+
+/* non reentrant interface, operating on the default game */
+int game_init(const char *fen)
+{
+	int err = init_game(&default_game, fen);
+	assert(err != 1);
+	return err;
+}
+void game_terminate(void)
+{
+	free(default_game.plies);
+}
+int game_load_book(const char *fname)
+{
+	if (book) {
+		book_close(book);
+		book = NULL;
+	}
+	if (!fname)
+		return 0;
+
+	book = book_open(fname);
+	return book ? 0 : 1;
+}
+int game_load_network(const char *fname)
+{
+	if (network) {
+		nnue_unload(network);
+		network = NULL;
+	}
+	if (!fname)
+		return 0;
+
+	nnue_init();
+	network = nnue_load(fname);
+	++network_generation;
+	return network ? 0 : 1;
+}
+int game_exec_ply(move_t m)
+{
+	return game_exec_ply_r(&default_game, m);
+}
+int game_exec_move(move_t m)
+{
+	return game_exec_move_r(&default_game, m);
+}
+void game_undo_last_ply(void)
+{
+	game_undo_last_ply_r(&default_game);
+}
+int game_generate_legal_moves(move_t *moves)
+{
+	return game_generate_legal_moves_r(&default_game, moves);
+}
+color_t game_get_active_color(void)
+{
+	return game_get_active_color_r(&default_game);
+}
+piece_t game_get_piece(sqid i, sqid j)
+{
+	return game_get_piece_r(&default_game, i, j);
+}
+color_t game_get_color(sqid i, sqid j)
+{
+	return game_get_color_r(&default_game, i, j);
+}
+squareinfo_t game_get_squareinfo(sqid i, sqid j)
+{
+	return game_get_squareinfo_r(&default_game, i, j);
+}
+uint64_t game_get_hash(void)
+{
+	return game_get_hash_r(&default_game);
+}
+unsigned int game_get_ply_number(void)
+{
+	return game_get_ply_number_r(&default_game);
+}
+int game_get_move_number(void)
+{
+	return game_get_move_number_r(&default_game);
+}
+unsigned long game_get_allocation_count(void)
+{
+	return game_get_allocation_count_r(&default_game);
+}
+int game_is_stalemate(void)
+{
+	return game_is_stalemate_r(&default_game);
+}
+int game_is_checkmate(void)
+{
+	return game_is_checkmate_r(&default_game);
+}
+uint64_t game_get_legal_targets(sqid i, sqid j)
+{
+	return game_get_legal_targets_r(&default_game, i, j);
+}
+int game_is_movable_piece_at(sqid i, sqid j)
+{
+	return game_is_movable_piece_at_r(&default_game, i, j);
+}
+int game_is_check(void)
+{
+	return game_is_check_r(&default_game);
+}
+int game_is_repetition(void)
+{
+	return game_is_repetition_r(&default_game);
+}
+int game_last_ply_was_capture(void)
+{
+	return game_last_ply_was_capture_r(&default_game);
+}
+int game_has_sufficient_mating_material(color_t color)
+{
+	return game_has_sufficient_mating_material_r(&default_game, color);
+}
+int game_see(move_t m)
+{
+	return game_see_r(&default_game, m);
+}
+int game_evaluate(void)
+{
+	return game_evaluate_r(&default_game);
+}
+int game_book_moves(move_t *moves, unsigned int *weights)
+{
+	return game_book_moves_r(&default_game, moves, weights);
+}
+int game_get_material_balance(void)
+{
+	return game_get_material_balance_r(&default_game);
+}
+int game_get_psq_score(void)
+{
+	return game_get_psq_score_r(&default_game);
+}
+int game_get_piece_count(color_t color, piece_t piece)
+{
+	return game_get_piece_count_r(&default_game, color, piece);
+}
+void game_get_status(status_t *externstatus)
+{
+	game_get_status_r(&default_game, externstatus);
+}
+size_t game_get_updates(unsigned int nply, sqid squares[][2], int alsoindirect)
+{
+	return game_get_updates_r(&default_game, nply, squares, alsoindirect);
+}
+int game_load_fen(const char *s)
+{
+	return game_load_fen_r(&default_game, s);
+}
 void game_get_fen(char *s)
 {
-	format_fen(position, active_color, castlerights, fep, drawish_plies_num, nmove, s);
+	game_get_fen_r(&default_game, s);
 }
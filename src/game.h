@@ -19,12 +19,20 @@
 #ifndef GAME_H
 #define GAME_H
 
+#include <stdint.h>
+
 #include "pwn.h"
 
 #define NF 8
 #define PIECES_NUM 6
 #define COLORS_NUM 2
 
+/* squares are numbered rank by rank, a1 = 0, b1 = 1, ..., h8 = 63 */
+#define SQUARES_NUM (NF * NF)
+#define SQ(i, j) ((j) * NF + (i))
+#define SQ_FILE(s) ((s) % NF)
+#define SQ_RANK(s) ((s) / NF)
+
 #define OPP_COLOR(c) ((c) ^ COLORMASK)
 #define PIECE_IDX(p) ((p) / 2 - 1)
 #define PIECE_BY_IDX(i) (2 * (i) + 2)
@@ -68,30 +76,135 @@ typedef enum piece_t piece_t;
 typedef int sqid;
 typedef int squareinfo_t;
 typedef struct ply_t ply_t;
+typedef uint16_t move_t;
+typedef struct game_t game_t;
 typedef enum status_t status_t;
 
 #define STARTPOS_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
 
 #define UPDATES_NUM_MAX 4
 
-
+/* upper bound for the number of legal moves in any position */
+#define MOVES_MAX 256
+
+/* moves are packed into 16 bits: from and to square in the lower twelve
+   bits, the promotion piece above and a flag in the top two bits.
+   Castling and en passant flags are filled in by the move generator,
+   moves built from squares only carry the promotion */
+#define MOVE_NONE 0
+#define MOVE_FLAG_PROMOTION (1 << 14)
+#define MOVE_FLAG_EN_PASSANT (2 << 14)
+#define MOVE_FLAG_CASTLE (3 << 14)
+
+#define MOVE(from, to) ((move_t)((from) | (to) << 6))
+#define MOVE_PROMOTION(from, to, p) ((move_t)(MOVE(from, to) \
+			| (PIECE_IDX(p) - PIECE_IDX(PIECE_QUEEN)) << 12 | MOVE_FLAG_PROMOTION))
+#define MOVE_FROM(m) ((m) & 0x3f)
+#define MOVE_TO(m) (((m) >> 6) & 0x3f)
+#define MOVE_FLAGS(m) ((m) & (3 << 14))
+#define MOVE_PROMPIECE(m) (MOVE_FLAGS(m) == MOVE_FLAG_PROMOTION \
+		? PIECE_BY_IDX(((m) >> 12 & 3) + PIECE_IDX(PIECE_QUEEN)) : PIECE_NONE)
+
+
+move_t game_pack_move(const sqid from[2], const sqid to[2], piece_t prompiece);
+void game_unpack_move(move_t m, sqid from[2], sqid to[2], piece_t *prompiece);
+
+/* reentrant interface, every game_t holds a complete game and is
+   independent of all others */
+game_t *game_create(const char *fen);
+game_t *game_copy(const game_t *g);
+void game_destroy(game_t *g);
+
+int game_exec_ply_r(game_t *g, move_t m);
+int game_exec_move_r(game_t *g, move_t m);
+void game_undo_last_ply_r(game_t *g);
+int game_generate_legal_moves_r(game_t *g, move_t *moves);
+
+/* destinations of the piece on (i, j), square SQ(i', j') as bit SQ(i', j') */
+uint64_t game_get_legal_targets_r(game_t *g, sqid i, sqid j);
+int game_is_movable_piece_at_r(const game_t *g, sqid i, sqid j);
+int game_is_check_r(game_t *g);
+/* has the current position occured before, since the last irreversible ply */
+int game_is_repetition_r(game_t *g);
+int game_last_ply_was_capture_r(const game_t *g);
+int game_has_sufficient_mating_material_r(const game_t *g, color_t color);
+void game_get_status_r(game_t *g, status_t *externstatus);
+
+color_t game_get_active_color_r(const game_t *g);
+piece_t game_get_piece_r(const game_t *g, sqid i, sqid j);
+color_t game_get_color_r(const game_t *g, sqid i, sqid j);
+squareinfo_t game_get_squareinfo_r(const game_t *g, sqid i, sqid j);
+uint64_t game_get_hash_r(const game_t *g);
+unsigned int game_get_ply_number_r(const game_t *g);
+size_t game_get_updates_r(const game_t *g, unsigned int nply, sqid squares[][2], int alsoindirect);
+int game_get_move_number_r(const game_t *g);
+int game_get_piece_count_r(const game_t *g, color_t color, piece_t piece);
+
+/* material result of m in centipawns for the moving side, when both
+   sides go on capturing on its target square with their least valuable
+   pieces and may stop at any time */
+int game_see_r(const game_t *g, move_t m);
+/* material value of a piece in centipawns as game_see_r() counts it */
+int game_get_piece_value(piece_t p);
+/* static evaluation in centipawns for the side to move, by the loaded
+   network if there is one and by material and piece-square tables
+   otherwise */
+int game_evaluate_r(game_t *g);
+/* both kept up to date while plies are executed, in centipawns for
+   white: the material difference without kings and the material and
+   piece-square score tapered between middlegame and endgame by the
+   pieces left */
+int game_get_material_balance_r(const game_t *g);
+int game_get_psq_score_r(const game_t *g);
+/* the legal moves the loaded opening book has for the position, with
+   the most weighted first. weights may be NULL */
+int game_book_moves_r(game_t *g, move_t *moves, unsigned int *weights);
+int game_is_same_position_r(const game_t *a, const game_t *b);
+unsigned long game_get_allocation_count_r(const game_t *g);
+
+int game_load_fen_r(game_t *g, const char *s);
+void game_get_fen_r(const game_t *g, char *s);
+
+/* the same interface operating on a single default game */
 int game_init(const char *fen);
 void game_terminate(void);
 
-int game_exec_ply(sqid ifrom, sqid jfrom, sqid ito, sqid jto, piece_t prompiece);
+/* loads the network weights of fname for the evaluation of all games,
+   NULL goes back to the classical evaluation. Returns 1 if the file
+   could not be mapped or has the wrong format */
+int game_load_network(const char *fname);
+/* maps the polyglot book fname for game_book_moves_r() of all games,
+   NULL closes it. Returns 1 if the file could not be mapped */
+int game_load_book(const char *fname);
+
+int game_exec_ply(move_t m);
+int game_exec_move(move_t m);
 void game_undo_last_ply(void);
+int game_generate_legal_moves(move_t *moves);
 
+uint64_t game_get_legal_targets(sqid i, sqid j);
 int game_is_movable_piece_at(sqid i, sqid j);
+int game_is_check(void);
+int game_is_repetition(void);
 int game_last_ply_was_capture(void);
+int game_has_sufficient_mating_material(color_t color);
 void game_get_status(status_t *externstatus);
 
 color_t game_get_active_color(void);
 piece_t game_get_piece(sqid i, sqid j);
 color_t game_get_color(sqid i, sqid j);
 squareinfo_t game_get_squareinfo(sqid i, sqid j);
+uint64_t game_get_hash(void);
 unsigned int game_get_ply_number(void);
 size_t game_get_updates(unsigned int nply, sqid squares[][2], int alsoindirect);
 int game_get_move_number();
+int game_get_piece_count(color_t color, piece_t piece);
+int game_see(move_t m);
+int game_evaluate(void);
+int game_get_material_balance(void);
+int game_get_psq_score(void);
+int game_book_moves(move_t *moves, unsigned int *weights);
+unsigned long game_get_allocation_count(void);
 
 int game_load_fen(const char *s);
 void game_get_fen(char *s);
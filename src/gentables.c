@@ -0,0 +1,303 @@
+/*  pwn - simple multiplayer chess game
+ *
+ *  Copyright (C) 2020 Jona Ackerschott
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/* gentables - write the attack and geometry tables to a c source file,
+   so that they are computed once at build time instead of on every
+   startup */
+
+#include <stdio.h>
+
+#include "tables.h"
+
+static const int knight_steps[][2] = {
+	{1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2},
+};
+static const int king_steps[][2] = {
+	{1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}, {1, -1},
+};
+static const int white_pawn_steps[][2] = {
+	{-1, 1}, {1, 1},
+};
+static const int black_pawn_steps[][2] = {
+	{-1, -1}, {1, -1},
+};
+static const int ray_dirs[RAYS_NUM][2] = {
+	[RAY_EAST] = {1, 0},
+	[RAY_NORTH] = {0, 1},
+	[RAY_NORTHEAST] = {1, 1},
+	[RAY_NORTHWEST] = {-1, 1},
+	[RAY_WEST] = {-1, 0},
+	[RAY_SOUTH] = {0, -1},
+	[RAY_SOUTHWEST] = {-1, -1},
+	[RAY_SOUTHEAST] = {1, -1},
+};
+static const int rook_rays[] = { RAY_EAST, RAY_NORTH, RAY_WEST, RAY_SOUTH };
+static const int bishop_rays[] = { RAY_NORTHEAST, RAY_NORTHWEST, RAY_SOUTHWEST, RAY_SOUTHEAST };
+
+static const bitboard_t rook_magic_numbers[SQUARES_NUM] = {
+	0x008000908064c000ULL, 0x0040200040001000ULL, 0x0180100080a0010aULL,
+	0x8880041000800800ULL, 0x1200100201200804ULL, 0x0200020004011008ULL,
+	0x2180010000800600ULL, 0x0200005088210204ULL, 0x0400800040008021ULL,
+	0x0400400020005000ULL, 0x8240801000200080ULL, 0x8611001004200900ULL,
+	0x008180800c001800ULL, 0x0100800200800400ULL, 0x0a02000102000408ULL,
+	0x8020802300104280ULL, 0x0080004000402000ULL, 0xe010104000402000ULL,
+	0x0800808010002000ULL, 0xa280210008100100ULL, 0x0001818014000800ULL,
+	0xa002010100080400ULL, 0x0080240001020870ULL, 0x0001020004048845ULL,
+	0x0081826280004004ULL, 0x2020810900284000ULL, 0x0200100080802000ULL,
+	0x0200080080100080ULL, 0x8083080100100500ULL, 0x4406000901000400ULL,
+	0x0005020080800100ULL, 0x0090204200008114ULL, 0x0010400094800420ULL,
+	0x0900804000802002ULL, 0x0201001841002000ULL, 0x4100080080801000ULL,
+	0x4540040080800800ULL, 0x0002001004040020ULL, 0x0281195814001002ULL,
+	0x1240800040800100ULL, 0x0880042000524004ULL, 0x02c080410206002cULL,
+	0x0801200241050010ULL, 0x8400080010008080ULL, 0x0008000500090010ULL,
+	0x0082009084020008ULL, 0x4012000108020004ULL, 0x9000104d08860004ULL,
+	0x2004204114800100ULL, 0x0148802112400300ULL, 0x0202842000100880ULL,
+	0x001b080080900080ULL, 0x001a002008100600ULL, 0x0004008004020080ULL,
+	0x5181000600040300ULL, 0x0000044401128a00ULL, 0x8044110480002441ULL,
+	0x2008110084402202ULL, 0x90806005090010c1ULL, 0x000420310a004a42ULL,
+	0x0023001004020801ULL, 0x0882001008040102ULL, 0x000230088118020cULL,
+	0x0000019025040042ULL
+};
+static const bitboard_t bishop_magic_numbers[SQUARES_NUM] = {
+	0x0045010808008680ULL, 0x2002080204004898ULL, 0x0210009a10400006ULL,
+	0x0824050200810200ULL, 0x0006061105004090ULL, 0x00010108c0000000ULL,
+	0x0814040282104004ULL, 0x0012012201106800ULL, 0x10823014100c1040ULL,
+	0x0080c2088802808cULL, 0x0281108410404000ULL, 0x0101212041826200ULL,
+	0x0020141028221058ULL, 0x2201020202200202ULL, 0x000082a801482000ULL,
+	0x0000008401411044ULL, 0x0007103014300404ULL, 0x0002091110010100ULL,
+	0x42140012040c0808ULL, 0x0800808802004020ULL, 0x90c4004210140000ULL,
+	0x0800200900a01000ULL, 0x00d0400201108810ULL, 0x80820183814412a0ULL,
+	0x00a01008202202b4ULL, 0x01c2021a09500402ULL, 0x0084440208042400ULL,
+	0x800400400c090100ULL, 0xba10040010802100ULL, 0xd182009006005000ULL,
+	0x5011021001009004ULL, 0x0020420200510400ULL, 0x0292104000468800ULL,
+	0x00043009091c0500ULL, 0x0280441000020025ULL, 0x0042820080080080ULL,
+	0x0440101010010040ULL, 0x1000900100808080ULL, 0x0108108120089800ULL,
+	0x0044010200012682ULL, 0xc002500420900400ULL, 0x0040482210710800ULL,
+	0x0002060024000200ULL, 0x0281020a44000800ULL, 0xa0021200a4000200ULL,
+	0x0001301000840840ULL, 0x2868500108444220ULL, 0x0004111041000200ULL,
+	0x8044020842080200ULL, 0x0000220104210200ULL, 0x0000021201044000ULL,
+	0x0000280884040028ULL, 0x4012114010858003ULL, 0x0000081004082b88ULL,
+	0x3892700508208002ULL, 0x00220a041b060400ULL, 0x0812020284014881ULL,
+	0x010434a282103100ULL, 0x0490400824020800ULL, 0x4a20002c00208800ULL,
+	0x000000a011020200ULL, 0x4002940a02482202ULL, 0x5100100202140406ULL,
+	0x02102000840540c1ULL
+};
+
+static bitboard_t rays_table[RAYS_NUM][SQUARES_NUM];
+static struct magic_t magics[SQUARES_NUM];
+static bitboard_t table[ROOK_TABLE_SIZE];
+
+static int is_on_board(int i, int j)
+{
+	return i >= 0 && i < NF && j >= 0 && j < NF;
+}
+static bitboard_t leaper_attacks(int s, const int steps[][2], int nsteps)
+{
+	bitboard_t b = 0;
+	for (int k = 0; k < nsteps; ++k) {
+		int i = SQ_FILE(s) + steps[k][0];
+		int j = SQ_RANK(s) + steps[k][1];
+		if (is_on_board(i, j))
+			b |= BB(SQ(i, j));
+	}
+	return b;
+}
+static bitboard_t ray(int s, int dir)
+{
+	bitboard_t b = 0;
+	const int *d = ray_dirs[dir];
+	for (int i = SQ_FILE(s) + d[0], j = SQ_RANK(s) + d[1]; is_on_board(i, j);
+			i += d[0], j += d[1])
+		b |= BB(SQ(i, j));
+	return b;
+}
+static bitboard_t ray_attacks(int s, bitboard_t occ, const int dirs[4])
+{
+	bitboard_t b = 0;
+	for (int k = 0; k < 4; ++k) {
+		const int *d = ray_dirs[dirs[k]];
+		for (int i = SQ_FILE(s) + d[0], j = SQ_RANK(s) + d[1]; is_on_board(i, j);
+				i += d[0], j += d[1]) {
+			b |= BB(SQ(i, j));
+			if (occ & BB(SQ(i, j)))
+				break;
+		}
+	}
+	return b;
+}
+
+/* blockers on the last square of a ray don't change the attacks */
+static bitboard_t relevant_occupancy_mask(int s, const int dirs[4])
+{
+	bitboard_t b = 0;
+	for (int k = 0; k < 4; ++k) {
+		const int *d = ray_dirs[dirs[k]];
+		for (int i = SQ_FILE(s) + d[0], j = SQ_RANK(s) + d[1];
+				is_on_board(i + d[0], j + d[1]); i += d[0], j += d[1])
+			b |= BB(SQ(i, j));
+	}
+	return b;
+}
+
+/* n bitboards in rows of rowlen, every row of a two dimensional table
+   gets its own braces */
+static void write_bitboards(FILE *f, const char *decl, const bitboard_t *b, int n, int rowlen)
+{
+	int nested = rowlen != n;
+	fprintf(f, "%s = {", decl);
+	for (int r = 0; r < n; r += rowlen) {
+		if (nested)
+			fprintf(f, "\n\t{");
+		for (int k = 0; k < rowlen; ++k) {
+			fprintf(f, "%s0x%016llxULL,", k % 4 ? " " : nested ? "\n\t\t" : "\n\t",
+					(unsigned long long)b[r + k]);
+		}
+		if (nested)
+			fprintf(f, "\n\t},");
+	}
+	fprintf(f, "\n};\n");
+}
+static void write_magics(FILE *f, const char *name)
+{
+	fprintf(f, "const struct magic_t %s[SQUARES_NUM] = {\n", name);
+	for (int s = 0; s < SQUARES_NUM; ++s) {
+		fprintf(f, "\t{ 0x%016llxULL, 0x%016llxULL, %u, %d },\n",
+				(unsigned long long)magics[s].mask,
+				(unsigned long long)magics[s].magic,
+				magics[s].offset, magics[s].shift);
+	}
+	fprintf(f, "};\n");
+}
+
+static void write_leapers(FILE *f)
+{
+	bitboard_t b[COLORS_NUM * SQUARES_NUM];
+	for (int s = 0; s < SQUARES_NUM; ++s)
+		b[s] = leaper_attacks(s, knight_steps, ARRNUM(knight_steps));
+	write_bitboards(f, "const bitboard_t knight_attacks[SQUARES_NUM]", b,
+			SQUARES_NUM, SQUARES_NUM);
+
+	for (int s = 0; s < SQUARES_NUM; ++s)
+		b[s] = leaper_attacks(s, king_steps, ARRNUM(king_steps));
+	write_bitboards(f, "const bitboard_t king_attacks[SQUARES_NUM]", b,
+			SQUARES_NUM, SQUARES_NUM);
+
+	for (int s = 0; s < SQUARES_NUM; ++s) {
+		b[COLOR_WHITE * SQUARES_NUM + s] =
+			leaper_attacks(s, white_pawn_steps, ARRNUM(white_pawn_steps));
+		b[COLOR_BLACK * SQUARES_NUM + s] =
+			leaper_attacks(s, black_pawn_steps, ARRNUM(black_pawn_steps));
+	}
+	write_bitboards(f, "const bitboard_t pawn_attacks[COLORS_NUM][SQUARES_NUM]",
+			b, COLORS_NUM * SQUARES_NUM, SQUARES_NUM);
+}
+static void write_lines(FILE *f)
+{
+	static bitboard_t between[SQUARES_NUM][SQUARES_NUM];
+	static bitboard_t line[SQUARES_NUM][SQUARES_NUM];
+	for (int s = 0; s < SQUARES_NUM; ++s) {
+		for (int dir = 0; dir < RAYS_NUM; ++dir) {
+			bitboard_t full = rays_table[dir][s] | rays_table[(dir + 4) % RAYS_NUM][s] | BB(s);
+			for (bitboard_t b = rays_table[dir][s]; b; b &= b - 1) {
+				int t = BB_LSB(b);
+				between[s][t] = rays_table[dir][s] & rays_table[(dir + 4) % RAYS_NUM][t];
+				line[s][t] = full;
+			}
+		}
+	}
+	write_bitboards(f, "const bitboard_t squares_between[SQUARES_NUM][SQUARES_NUM]",
+			&between[0][0], SQUARES_NUM * SQUARES_NUM, SQUARES_NUM);
+	write_bitboards(f, "const bitboard_t squares_line[SQUARES_NUM][SQUARES_NUM]",
+			&line[0][0], SQUARES_NUM * SQUARES_NUM, SQUARES_NUM);
+}
+
+/* the subsets of a mask are enumerated in increasing order (carry-rippler),
+   which is exactly the order in which pext numbers them */
+static void write_slider(FILE *f, const char *name, const int dirs[4],
+		const bitboard_t magicnums[SQUARES_NUM], int size)
+{
+	unsigned int offset = 0;
+	for (int s = 0; s < SQUARES_NUM; ++s) {
+		struct magic_t *m = &magics[s];
+		m->mask = relevant_occupancy_mask(s, dirs);
+		m->magic = magicnums[s];
+		m->shift = 64 - BB_POPCOUNT(m->mask);
+		m->offset = offset;
+		offset += 1U << BB_POPCOUNT(m->mask);
+	}
+	char decl[64];
+	snprintf(decl, sizeof(decl), "%s_magics", name);
+	write_magics(f, decl);
+
+	for (int s = 0; s < SQUARES_NUM; ++s) {
+		const struct magic_t *m = &magics[s];
+		bitboard_t occ = 0;
+		do {
+			table[m->offset + (((occ & m->mask) * m->magic) >> m->shift)] =
+				ray_attacks(s, occ, dirs);
+			occ = (occ - m->mask) & m->mask;
+		} while (occ);
+	}
+	snprintf(decl, sizeof(decl), "const bitboard_t %s_table_magic[%d]", name, size);
+	write_bitboards(f, decl, table, size, size);
+
+	for (int s = 0; s < SQUARES_NUM; ++s) {
+		const struct magic_t *m = &magics[s];
+		bitboard_t occ = 0;
+		unsigned int k = 0;
+		do {
+			table[m->offset + k++] = ray_attacks(s, occ, dirs);
+			occ = (occ - m->mask) & m->mask;
+		} while (occ);
+	}
+	snprintf(decl, sizeof(decl), "const bitboard_t %s_table_pext[%d]", name, size);
+	write_bitboards(f, decl, table, size, size);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2) {
+		fprintf(stderr, "usage: gentables output\n");
+		return 1;
+	}
+	FILE *f = fopen(argv[1], "w");
+	if (!f) {
+		perror(argv[1]);
+		return 1;
+	}
+
+	for (int dir = 0; dir < RAYS_NUM; ++dir) {
+		for (int s = 0; s < SQUARES_NUM; ++s)
+			rays_table[dir][s] = ray(s, dir);
+	}
+
+	fprintf(f, "/* generated by gentables, do not edit */\n\n");
+	fprintf(f, "#include \"tables.h\"\n\n");
+	write_leapers(f);
+	write_lines(f);
+	write_bitboards(f, "const bitboard_t rays[RAYS_NUM][SQUARES_NUM]",
+			&rays_table[0][0], RAYS_NUM * SQUARES_NUM, SQUARES_NUM);
+	write_slider(f, "rook", rook_rays, rook_magic_numbers, ROOK_TABLE_SIZE);
+	write_slider(f, "bishop", bishop_rays, bishop_magic_numbers, BISHOP_TABLE_SIZE);
+
+	if (fclose(f)) {
+		perror(argv[1]);
+		return 1;
+	}
+	return 0;
+}
@@ -36,6 +36,7 @@
 #include "audioh.h"
 #include "config.h"
 #include "draw.h"
+#include "engineh.h"
 #include "game.h"
 #include "notation.h"
 #include "util.h"
@@ -46,6 +47,10 @@
 
 int fopp;
 
+/* playing against the computer, fopp is the pipe the engine handler
+   answers on then and everything sent goes to it as events */
+static int computeropp;
+
 static struct handler_context_t *hctx;
 static int fevent;
 static int fconfirm;
@@ -67,6 +72,7 @@ static struct pollfd pfds[2];
 #define MOVEUPDATES_SIZE (UPDATES_NUM_MAX + 2)
 
 static sqid selsquare[2];
+static uint64_t seltargets; /* legal targets of the selected piece */
 static struct {
 	cairo_surface_t *surface;
 	double xorig;
@@ -92,6 +98,7 @@ static Atom atoms[ATOM_COUNT];
 #define INITMSG_MAXLEN (STRLEN("init ") 		\
 		+ INITCOLOR_MAXLEN + STRLEN(" ") 	\
 		+ TINTERVAL_COARSE_MAXLEN + STRLEN(" ") \
+		+ TINTERVAL_COARSE_MAXLEN + STRLEN(" ") \
 		+ TSTAMP_MAXLEN)
 #define MOVEMSG_MAXLEN (STRLEN("move ") 		\
 		+ MOVE_MAXLEN + STRLEN(" ") 		\
@@ -101,9 +108,11 @@ static Atom atoms[ATOM_COUNT];
 		+ STATMSG_NAME_MAXLEN)
 #define MSG_MAXLEN MAX(MAX(INITMSG_MAXLEN, MOVEMSG_MAXLEN), STATMSG_MAXLEN)
 
+#define SEEMSG_FORMAT " (your last move loses %i centipawns)"
+#define SEEMSG_MAXLEN (STRLEN(SEEMSG_FORMAT) + 10)
 #define TITLE_MAXLEN (TINTERVAL_COARSE_MAXLEN + STRLEN(" - ") 	\
 		+ TINTERVAL_COARSE_MAXLEN 			\
-		+ STATMSG_TEXTS_MAXLEN)
+		+ STATMSG_TEXTS_MAXLEN + SEEMSG_MAXLEN)
 
 #define STATMSG_NAME_MAXLEN 14
 static const char *statmsg_names[] = {
@@ -142,14 +151,13 @@ struct msg_init {
 	int type;
 	color_t color;
 	long gametime;
+	long moveinc;
 	long tstamp;
 };
 struct msg_playmove {
 	int type;
 	piece_t piece;
-	sqid from[2];
-	sqid to[2];
-	piece_t prompiece;
+	move_t move;
 	long tmove;
 	long tstamp;
 };
@@ -180,7 +188,9 @@ struct gameinfo_t {
 	color_t selfcolor;
 	status_t status;
 	long time;
+	long moveinc;
 	long tstart;
+	int seeloss; /* exchange loss of our last move, until the next status */
 	struct timeinfo_t tiself;
 	struct timeinfo_t tiopp;
 };
@@ -252,6 +262,11 @@ static void format_initmsg(struct msg_init *e, char *str)
 	*c = ' ';
 	++c;
 
+	len = format_timeinterval(e->moveinc, c, 1);
+	c += len;
+	*c = ' ';
+	++c;
+
 	len = format_timestamp(e->tstamp, c, 0);
 	c += len;
 
@@ -264,7 +279,10 @@ static void format_movemsg(struct msg_playmove *e, char *str)
 	strncpy(c, MOVEMSG_PREFIX " ", STRLEN(MOVEMSG_PREFIX " "));
 	c += STRLEN(MOVEMSG_PREFIX " ");
 
-	l = format_move(e->piece, e->from, e->to, e->prompiece, c);
+	sqid from[2], to[2];
+	piece_t prompiece;
+	game_unpack_move(e->move, from, to, &prompiece);
+	l = format_move(e->piece, from, to, prompiece, c);
 	c += l;
 
 	*c = ' ';
@@ -316,6 +334,12 @@ static int parse_initmsg(const char *str, struct msg_init *e)
 		return 1;
 	++c;
 
+	if (!(c = parse_timeinterval(c, &e->moveinc, 0)))
+		return 1;
+	if (*c != ' ')
+		return 1;
+	++c;
+
 	if (!(c = parse_timestamp(c, &e->tstamp)))
 		return 1;
 	if (*c != '\0')
@@ -331,8 +355,11 @@ static int parse_movemsg(const char *str, struct msg_playmove *e)
 	assert(strncmp(c, MOVEMSG_PREFIX " ", STRLEN(MOVEMSG_PREFIX " ")) == 0);
 	c += STRLEN(MOVEMSG_PREFIX " ");
 
-	if (!(c = parse_move(c, &e->piece, e->from, e->to, &e->prompiece)))
+	sqid from[2], to[2];
+	piece_t prompiece;
+	if (!(c = parse_move(c, &e->piece, from, to, &prompiece)))
 		return 1;
+	e->move = game_pack_move(from, to, prompiece);
 	if (*c != ' ') {
 		e->tmove = measure_move_time(ginfo.tiself.movestart);
 		return 0;
@@ -403,8 +430,41 @@ static int parse_msg(const char *str, union msg_t *e)
 	}
 	assert(0);
 }
+static int send_engine_msg(union msg_t *e)
+{
+	union engineh_event_t ev;
+	memset(&ev, 0, sizeof(ev));
+	if (e->type == GFXH_EVENT_PLAYMOVE) {
+		ev.playmove.type = ENGINEH_EVENT_PLAYMOVE;
+		ev.playmove.move = e->playmove.move;
+		ev.playmove.time = ginfo.time ? ginfo.tiopp.subtotal : 0;
+	} else {
+		ev.statuschange.type = ENGINEH_EVENT_STATUSCHANGE;
+		ev.statuschange.status = e->statuschange.status;
+	}
+	return hwrite(hctx->engineh.pevent[1], &ev, sizeof(ev));
+}
+static int recv_engine_msg(union msg_t *e)
+{
+	move_t m;
+	int err = hread(fopp, &m, sizeof(m));
+	if (err != 0)
+		return err;
+
+	/* the engine shares our clock, so its move took exactly as long
+	   as we measure */
+	memset(e, 0, sizeof(*e));
+	e->playmove.type = GFXH_EVENT_PLAYMOVE;
+	e->playmove.move = m;
+	e->playmove.tmove = measure_move_time(ginfo.tiopp.movestart);
+	e->playmove.tstamp = measure_timestamp();
+	return 0;
+}
 static int send_msg(union msg_t *e)
 {
+	if (computeropp)
+		return send_engine_msg(e);
+
 	char buf[MSG_MAXLEN + 1];
 	format_msg(e, buf);
 
@@ -416,6 +476,9 @@ static int send_msg(union msg_t *e)
 }
 static int recv_msg(union msg_t *e)
 {
+	if (computeropp)
+		return recv_engine_msg(e);
+
 	char buf[MSG_MAXLEN + 1];
 	int err = hrecv(fopp, buf, sizeof(buf));
 	if (err != 0)
@@ -478,6 +541,9 @@ static void show_status(struct gameinfo_t ginfo)
 	}
 
 	strcpy(c, statmsg_texts[ginfo.status]);
+	c += strlen(c);
+	if (ginfo.seeloss)
+		sprintf(c, SEEMSG_FORMAT, ginfo.seeloss);
 
 	pthread_mutex_lock(&hctx->xlock);
 	XStoreName(dpy, winmain, title);
@@ -576,8 +642,7 @@ static int prompt_promotion_piece(piece_t *p)
 	*p = PIECE_BY_IDX(i);
 	return 0;
 }
-static int apply_move(sqid from[2], sqid to[2], piece_t *piece, piece_t *prompiece,
-		long tmove, int oppmove)
+static int apply_move(move_t *m, piece_t *piece, long tmove, int oppmove)
 {
 	/* let time run only after the first move by white */
 	long deduction = tmove;
@@ -589,6 +654,9 @@ static int apply_move(sqid from[2], sqid to[2], piece_t *piece, piece_t *prompie
 	}
 
 	/* get piece */
+	sqid from[2], to[2];
+	piece_t prompiece;
+	game_unpack_move(*m, from, to, &prompiece);
 	if (piece) {
 		pthread_mutex_lock(&hctx->gamelock);
 		piece_t p = game_get_piece(from[0], from[1]);
@@ -596,17 +664,38 @@ static int apply_move(sqid from[2], sqid to[2], piece_t *piece, piece_t *prompie
 		*piece = p;
 	}
 
+	/* judge our own move on the flagged legal moves it can be, the
+	   promotion piece is only known once the move is applied */
+	move_t cands[4];
+	int sees[4];
+	int ncands = 0;
+	if (!oppmove) {
+		move_t moves[MOVES_MAX];
+		pthread_mutex_lock(&hctx->gamelock);
+		int n = game_generate_legal_moves(moves);
+		for (int i = 0; i < n && ncands < 4; ++i) {
+			if (MOVE_FROM(moves[i]) != MOVE_FROM(*m)
+					|| MOVE_TO(moves[i]) != MOVE_TO(*m))
+				continue;
+			cands[ncands] = moves[i];
+			sees[ncands] = game_see(moves[i]);
+			++ncands;
+		}
+		pthread_mutex_unlock(&hctx->gamelock);
+	}
+
 	/* apply move */
 	pthread_mutex_lock(&hctx->gamelock);
-	int ret = game_exec_ply(from[0], from[1], to[0], to[1], *prompiece);
+	int ret = game_exec_ply(*m);
 	pthread_mutex_unlock(&hctx->gamelock);
-	if (ret == 1) {
+	if (ret == -1) {
+		SYSERR();
+		gfxh_cleanup();
+		pthread_exit(NULL);
+	} else if (ret == 1) {
 		return 1;
-	} else if (*prompiece == PIECE_NONE && ret == 2) {
-		if (*prompiece != PIECE_NONE)
-			return 1;
-
-		ret = prompt_promotion_piece(prompiece);
+	} else if (ret == 2) {
+		ret = prompt_promotion_piece(&prompiece);
 		if (ret == -1) {
 			SYSERR();
 			gfxh_cleanup();
@@ -615,12 +704,21 @@ static int apply_move(sqid from[2], sqid to[2], piece_t *piece, piece_t *prompie
 			return 1;
 		}
 
+		*m = game_pack_move(from, to, prompiece);
 		pthread_mutex_lock(&hctx->gamelock);
-		ret = game_exec_ply(from[0], from[1], to[0], to[1], *prompiece);
+		ret = game_exec_ply(*m);
 		pthread_mutex_unlock(&hctx->gamelock);
 		assert(ret == 0);
 	}
 
+	/* the loss is only shown until the next status change, the reply
+	   of the opponent included */
+	ginfo.seeloss = 0;
+	for (int i = 0; i < ncands; ++i) {
+		if (MOVE_PROMPIECE(cands[i]) == prompiece)
+			ginfo.seeloss = MAX(-sees[i], 0);
+	}
+
 	/* get updates */
 	pthread_mutex_lock(&hctx->gamelock);
 	size_t nlastply = game_get_ply_number() - 1;
@@ -654,11 +752,11 @@ static int apply_move(sqid from[2], sqid to[2], piece_t *piece, piece_t *prompie
 
 	/* show status */
 	if (oppmove) {
-		ginfo.tiopp.total = ginfo.tiopp.subtotal - deduction;
+		ginfo.tiopp.total = ginfo.tiopp.subtotal - deduction + ginfo.moveinc;
 		ginfo.tiopp.subtotal = ginfo.tiopp.total;
 		ginfo.tiself.movestart = ginfo.tiopp.movestart + tmove;
 	} else {
-		ginfo.tiself.total = ginfo.tiself.subtotal - deduction;
+		ginfo.tiself.total = ginfo.tiself.subtotal - deduction + ginfo.moveinc;
 		ginfo.tiself.subtotal = ginfo.tiself.total;
 		ginfo.tiopp.movestart = ginfo.tiself.movestart + tmove;
 	}
@@ -669,6 +767,35 @@ static int apply_move(sqid from[2], sqid to[2], piece_t *piece, piece_t *prompie
 	return 0;
 }
 
+/* default highlight of a square, without selection */
+static square_highlight_t get_highlight(sqid i, sqid j)
+{
+	if ((i == moveupdates[0][0] && j == moveupdates[0][1])
+			|| (i == moveupdates[1][0] && j == moveupdates[1][1]))
+		return SQUARE_HIGHLIGHT_MOVE_INVOLVED;
+	return SQUARE_HIGHLIGHT_UNSELECTED;
+}
+static void draw_field(sqid i, sqid j, square_highlight_t hl)
+{
+	double fx = ITOX(i, board.xorig, board.squaresize, ginfo.selfcolor);
+	double fy = JTOY(j, board.yorig, board.squaresize, ginfo.selfcolor);
+
+	shade_t shade = (shade_t)(1 - (i + j) % 2);
+	pthread_mutex_lock(&hctx->xlock);
+	draw_square(fx, fy, board.squaresize, shade, hl);
+	pthread_mutex_unlock(&hctx->xlock);
+
+	pthread_mutex_lock(&hctx->gamelock);
+	piece_t piece = game_get_piece(i, j);
+	color_t color = game_get_color(i, j);
+	pthread_mutex_unlock(&hctx->gamelock);
+	if (piece) {
+		pthread_mutex_lock(&hctx->xlock);
+		draw_piece(fx, fy, board.squaresize, piece, (shade_t)color);
+		pthread_mutex_unlock(&hctx->xlock);
+	}
+}
+
 static void selectf(sqid f[2])
 {
 	pthread_mutex_lock(&hctx->xlock);
@@ -696,6 +823,13 @@ static void selectf(sqid f[2])
 		pthread_mutex_unlock(&hctx->xlock);
 	}
 
+	pthread_mutex_lock(&hctx->gamelock);
+	seltargets = game_get_legal_targets(f[0], f[1]);
+	pthread_mutex_unlock(&hctx->gamelock);
+	for (uint64_t b = seltargets; b; b &= b - 1)
+		draw_field(SQ_FILE(__builtin_ctzll(b)), SQ_RANK(__builtin_ctzll(b)),
+				SQUARE_HIGHLIGHT_LEGAL_TARGET);
+
 	pthread_mutex_lock(&hctx->xlock);
 	draw_commit();
 	pthread_mutex_unlock(&hctx->xlock);
@@ -729,6 +863,13 @@ static void unselectf(void)
 		pthread_mutex_unlock(&hctx->xlock);
 	}
 
+	for (uint64_t b = seltargets; b; b &= b - 1) {
+		sqid i = SQ_FILE(__builtin_ctzll(b));
+		sqid j = SQ_RANK(__builtin_ctzll(b));
+		draw_field(i, j, get_highlight(i, j));
+	}
+	seltargets = 0;
+
 	pthread_mutex_lock(&hctx->xlock);
 	draw_commit();
 	pthread_mutex_unlock(&hctx->xlock);
@@ -804,12 +945,11 @@ static void redraw(int width, int height)
 			double fy = JTOY(j, board.yorig, board.squaresize, ginfo.selfcolor);
 
 			shade_t shade = (shade_t)(1 - (i + j) % 2);
-			square_highlight_t hl = SQUARE_HIGHLIGHT_UNSELECTED;
+			square_highlight_t hl = get_highlight(i, j);
 			if (i == selsquare[0] && j == selsquare[1]) {
 				hl = SQUARE_HIGHLIGHT_SELECTED;
-			} else if ((i == moveupdates[0][0] && j == moveupdates[0][1])
-					|| (i == moveupdates[1][0] && j == moveupdates[1][1])) {
-				hl = SQUARE_HIGHLIGHT_MOVE_INVOLVED;
+			} else if (seltargets & ((uint64_t)1 << SQ(i, j))) {
+				hl = SQUARE_HIGHLIGHT_LEGAL_TARGET;
 			}
 			pthread_mutex_lock(&hctx->xlock);
 			draw_square(fx, fy, board.squaresize, shade, hl);
@@ -913,12 +1053,18 @@ static void handle_touch(struct gfxh_event_touch *e)
 				selectf(f);
 		}
 	} else if (selsquare[0] != -1) {
+		/* illegal drops are known from the selection already */
+		if (!(seltargets & ((uint64_t)1 << SQ(f[0], f[1])))) {
+			unselectf();
+			return;
+		}
+
 		long tmove = measure_move_time(ginfo.tiself.movestart);
 		long tstamp = measure_timestamp();
 
 		piece_t piece;
-		piece_t prompiece = PIECE_NONE;
-		int err = apply_move(selsquare, f, &piece, &prompiece, tmove, 0);
+		move_t move = game_pack_move(selsquare, f, PIECE_NONE);
+		int err = apply_move(&move, &piece, tmove, 0);
 		if (err == 1) {
 			unselectf();
 			return;
@@ -928,9 +1074,7 @@ static void handle_touch(struct gfxh_event_touch *e)
 		memset(&mmove, 0, sizeof(mmove));
 		mmove.playmove.type = GFXH_EVENT_PLAYMOVE;
 		mmove.playmove.piece = piece;
-		memcpy(mmove.playmove.from, selsquare, sizeof(mmove.playmove.from));
-		memcpy(mmove.playmove.to, f, sizeof(mmove.playmove.to));
-		mmove.playmove.prompiece = prompiece;
+		mmove.playmove.move = move;
 		mmove.playmove.tmove = tmove;
 		mmove.playmove.tstamp = tstamp;
 		err = send_msg(&mmove);
@@ -969,7 +1113,7 @@ static void handle_playmove(struct msg_playmove *e)
 		fprintf(stderr, "warning: move transmission time larger than %li\n", TRANSDIFF_MAX);
 	}
 
-	int err = apply_move(e->from, e->to, NULL, &e->prompiece, e->tmove, 1);
+	int err = apply_move(&e->move, NULL, e->tmove, 1);
 	if (err == 1) {
 		fprintf(stderr, "%s: received illegal move", __func__);
 		gfxh_cleanup();
@@ -1053,6 +1197,7 @@ static void handle_statuschange(struct msg_statuschange *e)
 	if (e->status != ginfo.status)
 		goto err_false_claim;
 
+	ginfo.seeloss = 0;
 	show_status(ginfo);
 
 	if (soundfname) {
@@ -1124,6 +1269,7 @@ static void handle_updatetime(void)
 		}
 
 		ginfo.status = status;
+		ginfo.seeloss = 0;
 		show_status(ginfo);
 	} else if (movetime >= time_status_updates_num * TIME_STATUS_UPDATE_INTERVAL) {
 		show_status(ginfo);
@@ -1134,6 +1280,9 @@ static void handle_updatetime(void)
 static void gfxh_setup(void)
 {
 	int err;
+	if (computeropp)
+		fopp = hctx->engineh.pconfirm[0];
+
 	if (fcntl(fevent, F_SETFL, O_NONBLOCK) == -1) {
 		SYSERR();
 		goto cleanup_err;
@@ -1275,7 +1424,8 @@ static void gfxh_cleanup(void)
 	cairo_surface_destroy(board.surface);
 	pthread_mutex_unlock(&hctx->xlock);
 
-	if (close(fopp) == -1)
+	/* the engine pipe is closed together with its handler */
+	if (!computeropp && close(fopp) == -1)
 		fprintf(stderr, "%s: error while closing communication socket\n", __func__);
 
 	if (close(fevent) == -1 || close(fconfirm) == -1)
@@ -1305,7 +1455,8 @@ void *gfxh_main(void *args)
 	return 0;
 }
 
-void init_communication_server(const char* node, const char *port, color_t color, long gametime)
+void init_communication_server(const char* node, const char *port, color_t color,
+		long gametime, long moveinc)
 {
 	int fsock = socket(AF_INET, SOCK_STREAM, 0);
 	if (fsock == -1) {
@@ -1358,6 +1509,7 @@ void init_communication_server(const char* node, const char *port, color_t color
 	m.init.type = GFXH_EVENT_INIT;
 	m.init.color = color;
 	m.init.gametime = gametime;
+	m.init.moveinc = moveinc;
 	m.init.tstamp = tstartreal;
 	err = send_msg(&m);
 	if (err == -1) {
@@ -1368,6 +1520,7 @@ void init_communication_server(const char* node, const char *port, color_t color
 
 	ginfo.selfcolor = color;
 	ginfo.time = gametime;
+	ginfo.moveinc = gametime ? moveinc : 0;
 	ginfo.tstart = tstart;
 }
 void init_communication_client(const char *node, const char *port)
@@ -1433,5 +1586,17 @@ void init_communication_client(const char *node, const char *port)
 
 	ginfo.selfcolor = m.init.color;
 	ginfo.time = m.init.gametime;
+	ginfo.moveinc = m.init.gametime ? m.init.moveinc : 0;
+	ginfo.tstart = tstart;
+}
+void init_communication_computer(color_t color, long gametime, long moveinc)
+{
+	long tstartreal, tstart;
+	measure_game_start(&tstartreal, &tstart);
+
+	computeropp = 1;
+	ginfo.selfcolor = color;
+	ginfo.time = gametime;
+	ginfo.moveinc = gametime ? moveinc : 0;
 	ginfo.tstart = tstart;
 }
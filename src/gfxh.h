@@ -19,6 +19,8 @@
 #ifndef GFXH_H
 #define GFXH_H
 
+#include <X11/Xlib.h>
+
 #include "pwn.h"
 #include "game.h"
 
@@ -82,8 +84,10 @@ struct gfxh_args_t {
 	Atom atoms[ATOM_COUNT];
 };
 
-void init_communication_server(const char* node, const char *port, color_t color, long gametime);
+void init_communication_server(const char* node, const char *port, color_t color,
+		long gametime, long moveinc);
 void init_communication_client(const char *node, const char *port);
+void init_communication_computer(color_t color, long gametime, long moveinc);
 
 void *gfxh_main(void *args);
 
@@ -0,0 +1,143 @@
+/*  pwn - simple multiplayer chess game
+ *
+ *  Copyright (C) 2020 Jona Ackerschott
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "cpu.h"
+#include "mailbox.h"
+
+static int kernels = -1;
+
+static bitboard_t find_scalar(const uint8_t *mb, uint8_t info, uint8_t mask)
+{
+	bitboard_t b = 0;
+	for (int s = 0; s < SQUARES_NUM; ++s) {
+		if ((mb[s] & mask) == info)
+			b |= BB(s);
+	}
+	return b;
+}
+static int equal_scalar(const uint8_t *a, const uint8_t *b)
+{
+	uint8_t diff = 0;
+	for (int s = 0; s < SQUARES_NUM; ++s)
+		diff |= a[s] ^ b[s];
+	return !diff;
+}
+
+#ifdef HAVE_SIMD
+/* the compare results are gathered into one bit per square, which is
+   a bitboard already since squares are numbered like the bits */
+__attribute__((target("sse2")))
+static bitboard_t find_sse2(const uint8_t *mb, uint8_t info, uint8_t mask)
+{
+	__m128i vinfo = _mm_set1_epi8(info);
+	__m128i vmask = _mm_set1_epi8(mask);
+	bitboard_t b = 0;
+	for (int k = 0; k < 4; ++k) {
+		__m128i x = _mm_loadu_si128((const __m128i *)mb + k);
+		x = _mm_cmpeq_epi8(_mm_and_si128(x, vmask), vinfo);
+		b |= (bitboard_t)(uint16_t)_mm_movemask_epi8(x) << (16 * k);
+	}
+	return b;
+}
+__attribute__((target("sse2")))
+static int equal_sse2(const uint8_t *a, const uint8_t *b)
+{
+	__m128i diff = _mm_setzero_si128();
+	for (int k = 0; k < 4; ++k) {
+		diff = _mm_or_si128(diff, _mm_xor_si128(_mm_loadu_si128((const __m128i *)a + k),
+				_mm_loadu_si128((const __m128i *)b + k)));
+	}
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) == 0xffff;
+}
+
+__attribute__((target("avx2")))
+static bitboard_t find_avx2(const uint8_t *mb, uint8_t info, uint8_t mask)
+{
+	__m256i vinfo = _mm256_set1_epi8(info);
+	__m256i vmask = _mm256_set1_epi8(mask);
+	__m256i lo = _mm256_loadu_si256((const __m256i *)mb);
+	__m256i hi = _mm256_loadu_si256((const __m256i *)mb + 1);
+	lo = _mm256_cmpeq_epi8(_mm256_and_si256(lo, vmask), vinfo);
+	hi = _mm256_cmpeq_epi8(_mm256_and_si256(hi, vmask), vinfo);
+	return (bitboard_t)(uint32_t)_mm256_movemask_epi8(lo)
+		| (bitboard_t)(uint32_t)_mm256_movemask_epi8(hi) << 32;
+}
+__attribute__((target("avx2")))
+static int equal_avx2(const uint8_t *a, const uint8_t *b)
+{
+	__m256i lo = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)a),
+			_mm256_loadu_si256((const __m256i *)b));
+	__m256i hi = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)a + 1),
+			_mm256_loadu_si256((const __m256i *)b + 1));
+	__m256i diff = _mm256_or_si256(lo, hi);
+	return _mm256_testz_si256(diff, diff);
+}
+#endif
+
+int mb_set_kernels(int k)
+{
+#ifdef HAVE_SIMD
+	if (k == MB_KERNELS_SSE2 && !cpu_has_sse2())
+		return 1;
+	if (k == MB_KERNELS_AVX2 && !cpu_has_avx2())
+		return 1;
+#else
+	if (k != MB_KERNELS_SCALAR)
+		return 1;
+#endif
+	kernels = k;
+	return 0;
+}
+int mb_get_kernels(void)
+{
+	return kernels;
+}
+
+void mb_init(void)
+{
+	if (kernels != -1)
+		return;
+
+	if (mb_set_kernels(MB_KERNELS_AVX2) && mb_set_kernels(MB_KERNELS_SSE2))
+		mb_set_kernels(MB_KERNELS_SCALAR);
+}
+
+bitboard_t mb_find(const uint8_t mailbox[SQUARES_NUM], uint8_t info, uint8_t mask)
+{
+#ifdef HAVE_SIMD
+	if (kernels == MB_KERNELS_AVX2)
+		return find_avx2(mailbox, info, mask);
+	if (kernels == MB_KERNELS_SSE2)
+		return find_sse2(mailbox, info, mask);
+#endif
+	return find_scalar(mailbox, info, mask);
+}
+int mb_count(const uint8_t mailbox[SQUARES_NUM], uint8_t info, uint8_t mask)
+{
+	return BB_POPCOUNT(mb_find(mailbox, info, mask));
+}
+int mb_equal(const uint8_t a[SQUARES_NUM], const uint8_t b[SQUARES_NUM])
+{
+#ifdef HAVE_SIMD
+	if (kernels == MB_KERNELS_AVX2)
+		return equal_avx2(a, b);
+	if (kernels == MB_KERNELS_SSE2)
+		return equal_sse2(a, b);
+#endif
+	return equal_scalar(a, b);
+}
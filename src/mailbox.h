@@ -0,0 +1,47 @@
+/*  pwn - simple multiplayer chess game
+ *
+ *  Copyright (C) 2020 Jona Ackerschott
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+#include <stdint.h>
+
+#include "bitboard.h"
+
+/* a mailbox is the board as one squareinfo byte per square, 64 bytes
+   that fit into a single cache line, so that whole board scans are a
+   few vector compares */
+#define MAILBOX_ALIGN 64
+
+/* ways of scanning a mailbox */
+enum {
+	MB_KERNELS_SCALAR,
+	MB_KERNELS_SSE2,
+	MB_KERNELS_AVX2,
+};
+
+void mb_init(void);
+int mb_set_kernels(int kernels);
+int mb_get_kernels(void);
+
+/* squares whose info masked with mask equals info */
+bitboard_t mb_find(const uint8_t mailbox[SQUARES_NUM], uint8_t info, uint8_t mask);
+int mb_count(const uint8_t mailbox[SQUARES_NUM], uint8_t info, uint8_t mask);
+int mb_equal(const uint8_t a[SQUARES_NUM], const uint8_t b[SQUARES_NUM]);
+
+#endif /* MAILBOX_H */
@@ -33,6 +33,7 @@
 
 #include "audioh.h"
 #include "config.h"
+#include "engineh.h"
 #include "game.h"
 #include "gfxh.h"
 #include "notation.h"
@@ -118,6 +119,15 @@ static int stop_handler(struct handler_t *h)
 	return ret;
 }
 
+static void stop_engine_handler(void)
+{
+	if (!(options.flags & OPTION_NO_OPPONENT))
+		return;
+
+	if (stop_handler(&hctx->engineh))
+		fprintf(stderr, "error while terminating engine handler thread\n");
+}
+
 static void on_client_message(XClientMessageEvent *e)
 {
 	union gfxh_event_t event;
@@ -243,7 +253,7 @@ static void parse_options(int argc, char *argv[])
 	char optstr[sizeof(":l:p:s:t:")] = "\0";
 	for (int i = 1; i < argc; ++i) {
 		if (strstr(argv[i], "-n") != NULL) {
-			strcpy(optstr, ":ns:");
+			strcpy(optstr, ":nb:s:t:");
 		} else if (strstr(argv[i], "-c") != NULL) {
 			strcpy(optstr, ":c:p:");
 		} else if (strstr(argv[i], "-l") != NULL) {
@@ -254,7 +264,7 @@ static void parse_options(int argc, char *argv[])
 		break;
 	}
 	if (optstr[0] == 0) {
-		strcpy(optstr, ":s:");
+		strcpy(optstr, ":b:s:t:");
 		flags = OPTION_NO_OPPONENT;
 	}
 
@@ -265,6 +275,10 @@ static void parse_options(int argc, char *argv[])
 		case 'n':
 			flags |= OPTION_NO_OPPONENT;
 			break;
+		case 'b':
+			if (game_load_book(optarg))
+				goto err_invalid_arg;
+			break;
 		case 'l':
 			flags |= OPTION_IS_SERVER;
 		case 'c':
@@ -312,7 +326,7 @@ static void parse_options(int argc, char *argv[])
 	} 
 
 	/* check options */
-	if (!port) {
+	if (!port && !(flags & OPTION_NO_OPPONENT)) {
 		fprintf(stderr, "missing option '-p'\n");
 		free(node);
 		free(port);
@@ -370,10 +384,12 @@ static void setup(void)
 {
 	int ret;
 
-	if (options.flags & OPTION_IS_SERVER) {
+	if (options.flags & OPTION_NO_OPPONENT) {
+		init_communication_computer(options.color, options.gametime, options.moveinc);
+	} else if (options.flags & OPTION_IS_SERVER) {
 		printf("server\n");
 		init_communication_server(options.node, options.port,
-				options.color, options.gametime);
+				options.color, options.gametime, options.moveinc);
 	} else {
 		printf("client\n");
 		init_communication_client(options.node, options.port);
@@ -423,9 +439,31 @@ static void setup(void)
 	pthread_mutex_init(&hctx->gfxhlock, NULL);
 	pthread_mutex_init(&hctx->mainlock, NULL);
 
+	/* the computer opponent is started first, the graphics handler
+	   listens on its pipe right away */
+	if (options.flags & OPTION_NO_OPPONENT) {
+		struct engineh_args_t *enginehargs = malloc(sizeof(*enginehargs));
+		if (!enginehargs) {
+			SYSERR();
+			free(hctx);
+			goto cleanup_err_threads;
+		}
+		enginehargs->hctx = hctx;
+		enginehargs->color = OPP_COLOR(options.color);
+		enginehargs->gametime = options.gametime;
+		enginehargs->moveinc = options.moveinc;
+		if (start_handler(enginehargs, 0, engineh_main, &hctx->engineh)) {
+			fprintf(stderr, "error while starting engine handler thread");
+			free(enginehargs);
+			free(hctx);
+			goto cleanup_err_threads;
+		}
+	}
+
 	struct gfxh_args_t *gfxhargs = malloc(sizeof(*gfxhargs));
 	if (!gfxhargs) {
 		SYSERR();
+		stop_engine_handler();
 		free(hctx);
 		goto cleanup_err_threads;
 	}
@@ -436,6 +474,7 @@ static void setup(void)
 	memcpy(gfxhargs->atoms, atoms, sizeof(atoms));
 	if (start_handler(gfxhargs, 0, gfxh_main, &hctx->gfxh)) {
 		fprintf(stderr, "error while starting graphics handler thread");
+		stop_engine_handler();
 		free(gfxhargs);
 		free(hctx);
 		goto cleanup_err_threads;
@@ -446,6 +485,7 @@ static void setup(void)
 		SYSERR();
 		if (stop_handler(&hctx->gfxh))
 			fprintf(stderr, "error while terminating graphics handler thread\n");
+		stop_engine_handler();
 		free(hctx);
 		goto cleanup_err_threads;
 	}
@@ -454,6 +494,7 @@ static void setup(void)
 		fprintf(stderr, "error while starting audio handler thread");
 		if (stop_handler(&hctx->gfxh))
 			fprintf(stderr, "error while terminating graphics handler thread\n");
+		stop_engine_handler();
 		free(audiohargs);
 		free(hctx);
 		goto cleanup_err_threads;
@@ -475,6 +516,7 @@ static void cleanup(void)
 		fprintf(stderr, "error while terminating graphics handler thread\n");
 	if (stop_handler(&hctx->audioh))
 		fprintf(stderr, "error while terminating audio handler thread\n");
+	stop_engine_handler();
 
 	pthread_mutex_destroy(&hctx->mainlock);
 	pthread_mutex_destroy(&hctx->gfxhlock);
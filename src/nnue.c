@@ -0,0 +1,275 @@
+/*  pwn - simple multiplayer chess game
+ *
+ *  Copyright (C) 2020 Jona Ackerschott
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cpu.h"
+#include "nnue.h"
+
+struct nnue_header_t {
+	char magic[8];
+	uint32_t version;
+	uint32_t nfeatures;
+	uint32_t nhidden;
+	uint32_t nl1;
+	uint8_t reserved[40];
+};
+/* the layout of a weight file, every array starts on a multiple of
+   NNUE_ALIGN bytes */
+struct nnue_file_t {
+	struct nnue_header_t header;
+	int16_t ftweights[NNUE_FEATURES][NNUE_HIDDEN];
+	int16_t ftbiases[NNUE_HIDDEN];
+	int16_t l1weights[NNUE_L1][COLORS_NUM * NNUE_HIDDEN];
+	int32_t l1biases[NNUE_L1];
+	int16_t outweights[NNUE_L1];
+	int32_t outbias;
+};
+
+struct nnue_t {
+	const struct nnue_file_t *f;
+	size_t size;
+};
+
+static int kernels = -1;
+
+/* the pieces of the perspective come first and its ranks count from
+   its own side of the board */
+static int feature_index(color_t perspective, squareinfo_t info, int s)
+{
+	color_t c = (info & COLORMASK) ^ perspective;
+	if (perspective == COLOR_BLACK)
+		s ^= SQUARES_NUM - NF;
+	return (c * PIECES_NUM + PIECE_IDX(info & PIECEMASK)) * SQUARES_NUM + s;
+}
+
+static int32_t output(const nnue_t *net, const int32_t *hidden)
+{
+	int32_t out = net->f->outbias;
+	for (int j = 0; j < NNUE_L1; ++j) {
+		int32_t h = MIN(MAX(hidden[j] >> NNUE_L1_SHIFT, 0), NNUE_ACTIVATION_MAX);
+		out += net->f->outweights[j] * h;
+	}
+	return out;
+}
+
+static void add_scalar(int16_t *acc, const int16_t *w)
+{
+	for (int k = 0; k < NNUE_HIDDEN; ++k)
+		acc[k] += w[k];
+}
+static void sub_scalar(int16_t *acc, const int16_t *w)
+{
+	for (int k = 0; k < NNUE_HIDDEN; ++k)
+		acc[k] -= w[k];
+}
+static int32_t forward_scalar(const nnue_t *net, const int16_t *own, const int16_t *opp)
+{
+	int16_t in[COLORS_NUM * NNUE_HIDDEN];
+	for (int k = 0; k < NNUE_HIDDEN; ++k) {
+		in[k] = MIN(MAX(own[k], 0), NNUE_ACTIVATION_MAX);
+		in[NNUE_HIDDEN + k] = MIN(MAX(opp[k], 0), NNUE_ACTIVATION_MAX);
+	}
+
+	int32_t hidden[NNUE_L1];
+	for (int j = 0; j < NNUE_L1; ++j) {
+		const int16_t *w = net->f->l1weights[j];
+		int32_t sum = net->f->l1biases[j];
+		for (int k = 0; k < COLORS_NUM * NNUE_HIDDEN; ++k)
+			sum += w[k] * in[k];
+		hidden[j] = sum;
+	}
+	return output(net, hidden);
+}
+
+#ifdef HAVE_SIMD
+__attribute__((target("avx2")))
+static void add_avx2(int16_t *acc, const int16_t *w)
+{
+	for (int k = 0; k < NNUE_HIDDEN; k += 16) {
+		__m256i a = _mm256_load_si256((const __m256i *)(acc + k));
+		__m256i b = _mm256_loadu_si256((const __m256i *)(w + k));
+		_mm256_store_si256((__m256i *)(acc + k), _mm256_add_epi16(a, b));
+	}
+}
+__attribute__((target("avx2")))
+static void sub_avx2(int16_t *acc, const int16_t *w)
+{
+	for (int k = 0; k < NNUE_HIDDEN; k += 16) {
+		__m256i a = _mm256_load_si256((const __m256i *)(acc + k));
+		__m256i b = _mm256_loadu_si256((const __m256i *)(w + k));
+		_mm256_store_si256((__m256i *)(acc + k), _mm256_sub_epi16(a, b));
+	}
+}
+/* products of neighbouring inputs are summed into 32 bits by madd, the
+   eight lanes are added up at the end */
+__attribute__((target("avx2")))
+static int32_t forward_avx2(const nnue_t *net, const int16_t *own, const int16_t *opp)
+{
+	int16_t in[COLORS_NUM * NNUE_HIDDEN] __attribute__((aligned(NNUE_ALIGN)));
+	__m256i zero = _mm256_setzero_si256();
+	__m256i max = _mm256_set1_epi16(NNUE_ACTIVATION_MAX);
+	for (int k = 0; k < NNUE_HIDDEN; k += 16) {
+		__m256i a = _mm256_load_si256((const __m256i *)(own + k));
+		__m256i b = _mm256_load_si256((const __m256i *)(opp + k));
+		_mm256_store_si256((__m256i *)(in + k), _mm256_min_epi16(_mm256_max_epi16(a, zero), max));
+		_mm256_store_si256((__m256i *)(in + NNUE_HIDDEN + k),
+				_mm256_min_epi16(_mm256_max_epi16(b, zero), max));
+	}
+
+	int32_t hidden[NNUE_L1];
+	for (int j = 0; j < NNUE_L1; ++j) {
+		const int16_t *w = net->f->l1weights[j];
+		__m256i sum = _mm256_setzero_si256();
+		for (int k = 0; k < COLORS_NUM * NNUE_HIDDEN; k += 16) {
+			__m256i x = _mm256_load_si256((const __m256i *)(in + k));
+			__m256i y = _mm256_loadu_si256((const __m256i *)(w + k));
+			sum = _mm256_add_epi32(sum, _mm256_madd_epi16(x, y));
+		}
+		__m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+		s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4e));
+		s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xb1));
+		hidden[j] = net->f->l1biases[j] + _mm_cvtsi128_si32(s);
+	}
+	return output(net, hidden);
+}
+#endif
+
+int nnue_set_kernels(int k)
+{
+#ifdef HAVE_SIMD
+	if (k == NNUE_KERNELS_AVX2 && !cpu_has_avx2())
+		return 1;
+#else
+	if (k != NNUE_KERNELS_SCALAR)
+		return 1;
+#endif
+	kernels = k;
+	return 0;
+}
+int nnue_get_kernels(void)
+{
+	return kernels;
+}
+
+void nnue_init(void)
+{
+	if (kernels != -1)
+		return;
+
+	if (nnue_set_kernels(NNUE_KERNELS_AVX2))
+		nnue_set_kernels(NNUE_KERNELS_SCALAR);
+}
+
+nnue_t *nnue_load(const char *fname)
+{
+	if (__BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__)
+		return NULL;
+
+	int fd = open(fname, O_RDONLY);
+	if (fd == -1)
+		return NULL;
+
+	struct stat st;
+	if (fstat(fd, &st) == -1 || st.st_size != sizeof(struct nnue_file_t)) {
+		close(fd);
+		return NULL;
+	}
+
+	void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return NULL;
+
+	const struct nnue_file_t *f = map;
+	if (memcmp(f->header.magic, NNUE_MAGIC, sizeof(NNUE_MAGIC)) != 0
+			|| f->header.version != NNUE_VERSION
+			|| f->header.nfeatures != NNUE_FEATURES
+			|| f->header.nhidden != NNUE_HIDDEN
+			|| f->header.nl1 != NNUE_L1) {
+		munmap(map, st.st_size);
+		return NULL;
+	}
+
+	nnue_t *net = malloc(sizeof(*net));
+	if (!net) {
+		munmap(map, st.st_size);
+		return NULL;
+	}
+	net->f = f;
+	net->size = st.st_size;
+	return net;
+}
+void nnue_unload(nnue_t *net)
+{
+	munmap((void *)net->f, net->size);
+	free(net);
+}
+
+void nnue_refresh(const nnue_t *net, struct nnue_accumulator_t *acc,
+		const uint8_t mailbox[SQUARES_NUM])
+{
+	memcpy(acc->v[COLOR_WHITE], net->f->ftbiases, sizeof(acc->v[COLOR_WHITE]));
+	memcpy(acc->v[COLOR_BLACK], net->f->ftbiases, sizeof(acc->v[COLOR_BLACK]));
+	for (int s = 0; s < SQUARES_NUM; ++s) {
+		if ((mailbox[s] & PIECEMASK) != PIECE_NONE)
+			nnue_add_piece(net, acc, mailbox[s], s);
+	}
+}
+void nnue_add_piece(const nnue_t *net, struct nnue_accumulator_t *acc, squareinfo_t info, int s)
+{
+	for (color_t c = COLOR_WHITE; c <= COLOR_BLACK; ++c) {
+		const int16_t *w = net->f->ftweights[feature_index(c, info, s)];
+#ifdef HAVE_SIMD
+		if (kernels == NNUE_KERNELS_AVX2) {
+			add_avx2(acc->v[c], w);
+			continue;
+		}
+#endif
+		add_scalar(acc->v[c], w);
+	}
+}
+void nnue_remove_piece(const nnue_t *net, struct nnue_accumulator_t *acc, squareinfo_t info, int s)
+{
+	for (color_t c = COLOR_WHITE; c <= COLOR_BLACK; ++c) {
+		const int16_t *w = net->f->ftweights[feature_index(c, info, s)];
+#ifdef HAVE_SIMD
+		if (kernels == NNUE_KERNELS_AVX2) {
+			sub_avx2(acc->v[c], w);
+			continue;
+		}
+#endif
+		sub_scalar(acc->v[c], w);
+	}
+}
+
+int nnue_evaluate(const nnue_t *net, const struct nnue_accumulator_t *acc, color_t c)
+{
+	int32_t out;
+#ifdef HAVE_SIMD
+	if (kernels == NNUE_KERNELS_AVX2)
+		out = forward_avx2(net, acc->v[c], acc->v[OPP_COLOR(c)]);
+	else
+#endif
+		out = forward_scalar(net, acc->v[c], acc->v[OPP_COLOR(c)]);
+	return out / NNUE_OUTPUT_SCALE;
+}
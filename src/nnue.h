@@ -0,0 +1,79 @@
+/*  pwn - simple multiplayer chess game
+ *
+ *  Copyright (C) 2020 Jona Ackerschott
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef NNUE_H
+#define NNUE_H
+
+#include <stdint.h>
+
+#include "game.h"
+
+/* an efficiently updatable network: one feature per piece and square,
+   seen from both sides, feeds a wide first layer whose sums are kept
+   per game and updated for the pieces a ply touches. The rest are two
+   small dense layers evaluated from the side to move */
+#define NNUE_FEATURES (COLORS_NUM * PIECES_NUM * SQUARES_NUM)
+#define NNUE_HIDDEN 256
+#define NNUE_L1 32
+
+/* activations are clipped to [0, NNUE_ACTIVATION_MAX], the first dense
+   layer is shifted back to that range and the output is scaled by
+   NNUE_OUTPUT_SCALE per centipawn */
+#define NNUE_ACTIVATION_MAX 127
+#define NNUE_L1_SHIFT 6
+#define NNUE_OUTPUT_SCALE 16
+
+/* weight files are little endian: a header of 64 bytes starting with
+   NNUE_MAGIC and the version, followed by the weights and biases of the
+   feature transformer, the first dense layer and the output, see
+   nnue_load() */
+#define NNUE_MAGIC "pwnnnue"
+#define NNUE_VERSION 1
+
+#define NNUE_ALIGN 32
+
+enum {
+	NNUE_KERNELS_SCALAR,
+	NNUE_KERNELS_AVX2,
+};
+
+typedef struct nnue_t nnue_t;
+
+/* first layer sums by perspective */
+struct nnue_accumulator_t {
+	int16_t v[COLORS_NUM][NNUE_HIDDEN] __attribute__((aligned(NNUE_ALIGN)));
+};
+
+void nnue_init(void);
+int nnue_set_kernels(int kernels);
+int nnue_get_kernels(void);
+
+/* the weights stay in the mapped file, processes loading the same file
+   share them */
+nnue_t *nnue_load(const char *fname);
+void nnue_unload(nnue_t *net);
+
+void nnue_refresh(const nnue_t *net, struct nnue_accumulator_t *acc,
+		const uint8_t mailbox[SQUARES_NUM]);
+void nnue_add_piece(const nnue_t *net, struct nnue_accumulator_t *acc, squareinfo_t info, int s);
+void nnue_remove_piece(const nnue_t *net, struct nnue_accumulator_t *acc, squareinfo_t info, int s);
+
+/* centipawns for color c */
+int nnue_evaluate(const nnue_t *net, const struct nnue_accumulator_t *acc, color_t c);
+
+#endif /* NNUE_H */
@@ -68,6 +68,22 @@ size_t format_move(piece_t piece, sqid from[2], sqid to[2], piece_t prompiece, c
 	assert(len <= MOVE_MAXLEN);
 	return len;
 }
+/* the squares only, as in e7e8q, like engines and tools exchange moves */
+size_t format_move_coordinates(move_t m, char *str)
+{
+	char *c = str;
+	c[0] = FILE_CHAR(SQ_FILE(MOVE_FROM(m)));
+	c[1] = RANK_CHAR(SQ_RANK(MOVE_FROM(m)));
+	c[2] = FILE_CHAR(SQ_FILE(MOVE_TO(m)));
+	c[3] = RANK_CHAR(SQ_RANK(MOVE_TO(m)));
+	c += 4;
+
+	if (MOVE_PROMPIECE(m) != PIECE_NONE) {
+		*c = piece_symbols[PIECE_IDX(MOVE_PROMPIECE(m))];
+		++c;
+	}
+	return c - str;
+}
 size_t format_timeinterval(long t, char *str, int coarse)
 {
 	size_t len;
@@ -245,7 +261,7 @@ char *parse_timestamp(const char *s, long *t)
 }
 
 size_t format_fen(squareinfo_t position[NF][NF], color_t active_color,
-		int castlerights[2], sqid fep[2], unsigned int ndrawplies, unsigned int nmove, char *s)
+		const int castlerights[2], const sqid fep[2], unsigned int ndrawplies, unsigned int nmove, char *s)
 {
 	char *c = s;
 
@@ -292,6 +308,7 @@ size_t format_fen(squareinfo_t position[NF][NF], color_t active_color,
 	/* castlerights */
 	if (castlerights[COLOR_WHITE] == 0 && castlerights[COLOR_BLACK] == 0) {
 		*c = '-';
+		++c;
 	} else {
 		if (castlerights[COLOR_WHITE] & CASTLERIGHT_KINGSIDE) {
 			*c = 'K';
@@ -412,8 +429,12 @@ char *parse_fen(const char *s, squareinfo_t position[NF][NF], color_t *active_co
 				return NULL;
 		}
 
-		castlerights[COLOR_WHITE] = rights & (CASTLERIGHT_KINGSIDE | CASTLERIGHT_QUEENSIDE);
-		castlerights[COLOR_BLACK] = (rights >> 2) & (CASTLERIGHT_KINGSIDE | CASTLERIGHT_QUEENSIDE);
+		for (color_t c = COLOR_WHITE; c <= COLOR_BLACK; ++c) {
+			if (rights & (1 << (2 * c)))
+				castlerights[c] |= CASTLERIGHT_KINGSIDE;
+			if (rights & (1 << (2 * c + 1)))
+				castlerights[c] |= CASTLERIGHT_QUEENSIDE;
+		}
 
 		c += i;
 	}
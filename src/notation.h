@@ -16,6 +16,7 @@ static const char *piece_names[PIECES_NUM];
 static const char *piece_symbols;
 
 #define MOVE_MAXLEN (STRLEN("Sg1-f3"))
+#define MOVE_COORD_MAXLEN (STRLEN("e7e8q"))
 
 #define FEN_BUFSIZE 1024
 
@@ -30,6 +31,7 @@ static const char *piece_symbols;
 #define TSTAMP_COARSE_MAXLEN (STRLEN("1970-01-01 00:00:00"))
 
 size_t format_move(piece_t piece, sqid from[2], sqid to[2], piece_t prompiece, char *str);
+size_t format_move_coordinates(move_t m, char *str);
 size_t format_timeinterval(long t, char *str, int coarse);
 size_t format_timestamp(long t, char *s, int coarse);
 
@@ -39,8 +41,8 @@ char *parse_move(const char *s, piece_t *piece,
 char *parse_timeinterval(const char *s, long *t, int onlycoarse);
 char *parse_timestamp(const char *s, long *t);
 
-size_t format_fen(squareinfo_t position[NF][NF], color_t active_color, int castlerights[2],
-		sqid fep[2], unsigned int ndrawplies, unsigned int nmove, char *s);
+size_t format_fen(squareinfo_t position[NF][NF], color_t active_color, const int castlerights[2],
+		const sqid fep[2], unsigned int ndrawplies, unsigned int nmove, char *s);
 char *parse_fen(const char *s, squareinfo_t position[NF][NF], color_t *active_color,
 		int castlerights[2], sqid fep[2], unsigned int *ndrawplies, unsigned int *nmove);
 
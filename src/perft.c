@@ -0,0 +1,367 @@
+/*  pwn - simple multiplayer chess game
+ *
+ *  Copyright (C) 2020 Jona Ackerschott
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/* pwn-perft - count the leaf nodes of the move tree of a position, to
+   verify and benchmark the move generator */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <pthread.h>
+
+#include "game.h"
+#include "notation.h"
+#include "pwn.h"
+#include "util.h"
+
+#define DEPTH_MAX 32
+#define THREADS_MAX 256
+#define HASHTABLE_MB_DEFAULT 16
+
+/* node counts of subtrees, keyed by position and remaining depth. The
+   table is shared by all threads without locking: an entry stores its
+   key xor its data, so an entry torn by concurrent writes fails the
+   check on probing instead of returning a wrong count */
+struct hashentry_t {
+	uint64_t check;
+	uint64_t data;
+};
+struct hashtable_t {
+	struct hashentry_t *entries;
+	uint64_t mask;
+};
+
+/* the depth is kept in the top byte of the data, the count below */
+#define HASHDATA(nnodes, depth) ((nnodes) | (uint64_t)(depth) << 56)
+#define HASHDATA_NNODES(data) ((data) & (((uint64_t)1 << 56) - 1))
+#define HASHDATA_DEPTH(data) ((data) >> 56)
+
+/* a subtree to count, given by the plies leading to it from the root */
+struct job_t {
+	int nroot;
+	int nplies;
+	move_t plies[2];
+	unsigned long long nnodes;
+
+	unsigned long long nprobes;
+	unsigned long long nhits;
+
+	/* set if a ply could not be executed, the count is void then */
+	int err;
+};
+struct jobqueue_t {
+	const game_t *g;
+	int depth;
+	struct hashtable_t *ht;
+
+	struct job_t *jobs;
+	int njobs;
+	int nnext;
+	pthread_mutex_t lock;
+
+	/* allocations of the game copies while counting, should stay 0 */
+	unsigned long nallocs;
+};
+
+static int hashtable_init(struct hashtable_t *ht, long mb)
+{
+	ht->entries = NULL;
+	ht->mask = 0;
+	if (mb == 0)
+		return 0;
+
+	/* largest power of two number of entries that fits */
+	uint64_t n = 1;
+	while (2 * n * sizeof(*ht->entries) <= (uint64_t)mb << 20)
+		n *= 2;
+
+	ht->entries = calloc(n, sizeof(*ht->entries));
+	if (!ht->entries)
+		return 1;
+	ht->mask = n - 1;
+	return 0;
+}
+static uint64_t hashtable_key(game_t *g, int depth)
+{
+	return game_get_hash_r(g) ^ (0x9e3779b97f4a7c15ULL * depth);
+}
+static int hashtable_probe(struct hashtable_t *ht, uint64_t key, int depth,
+		unsigned long long *nnodes)
+{
+	struct hashentry_t *e = &ht->entries[key & ht->mask];
+	uint64_t check = __atomic_load_n(&e->check, __ATOMIC_RELAXED);
+	uint64_t data = __atomic_load_n(&e->data, __ATOMIC_RELAXED);
+	if ((check ^ data) != key || HASHDATA_DEPTH(data) != depth)
+		return 0;
+
+	*nnodes = HASHDATA_NNODES(data);
+	return 1;
+}
+static void hashtable_store(struct hashtable_t *ht, uint64_t key, int depth,
+		unsigned long long nnodes)
+{
+	struct hashentry_t *e = &ht->entries[key & ht->mask];
+	uint64_t data = HASHDATA(nnodes, depth);
+	__atomic_store_n(&e->check, key ^ data, __ATOMIC_RELAXED);
+	__atomic_store_n(&e->data, data, __ATOMIC_RELAXED);
+}
+static double hashtable_occupancy(const struct hashtable_t *ht)
+{
+	uint64_t nused = 0;
+	for (uint64_t k = 0; k <= ht->mask; ++k)
+		nused += ht->entries[k].data != 0;
+	return (double)nused / (ht->mask + 1);
+}
+
+static unsigned long long perft(game_t *g, int depth, struct hashtable_t *ht,
+		struct job_t *job)
+{
+	move_t moves[MOVES_MAX];
+	int nmoves = game_generate_legal_moves_r(g, moves);
+
+	/* leaves don't have to be visited, counting them is enough */
+	if (depth == 1)
+		return nmoves;
+
+	unsigned long long nnodes = 0;
+	uint64_t key = 0;
+	if (ht->entries) {
+		key = hashtable_key(g, depth);
+		++job->nprobes;
+		if (hashtable_probe(ht, key, depth, &nnodes)) {
+			++job->nhits;
+			return nnodes;
+		}
+	}
+
+	/* a failed ply leaves the game behind, it is dropped by the caller */
+	for (int k = 0; k < nmoves; ++k) {
+		if (game_exec_move_r(g, moves[k])) {
+			job->err = 1;
+			return 0;
+		}
+		nnodes += perft(g, depth - 1, ht, job);
+		if (job->err)
+			return 0;
+		game_undo_last_ply_r(g);
+	}
+
+	if (ht->entries)
+		hashtable_store(ht, key, depth, nnodes);
+	return nnodes;
+}
+
+static struct job_t *take_job(struct jobqueue_t *q)
+{
+	pthread_mutex_lock(&q->lock);
+	struct job_t *job = q->nnext < q->njobs ? &q->jobs[q->nnext++] : NULL;
+	pthread_mutex_unlock(&q->lock);
+	return job;
+}
+static void *perft_thread(void *args)
+{
+	struct jobqueue_t *q = args;
+
+	/* every thread works on a private copy of the root position */
+	game_t *g = game_copy(q->g);
+	if (!g)
+		return (void *)1;
+	unsigned long nallocs = game_get_allocation_count_r(g);
+
+	struct job_t *job;
+	while ((job = take_job(q))) {
+		for (int k = 0; k < job->nplies && !job->err; ++k)
+			job->err = game_exec_move_r(g, job->plies[k]) != 0;
+
+		int depth = q->depth - job->nplies;
+		if (!job->err)
+			job->nnodes = depth > 0 ? perft(g, depth, q->ht, job) : 1;
+		if (job->err) {
+			game_destroy(g);
+			return (void *)1;
+		}
+
+		for (int k = 0; k < job->nplies; ++k)
+			game_undo_last_ply_r(g);
+	}
+
+	pthread_mutex_lock(&q->lock);
+	q->nallocs += game_get_allocation_count_r(g) - nallocs;
+	pthread_mutex_unlock(&q->lock);
+
+	game_destroy(g);
+	return NULL;
+}
+
+/* split the tree at the root moves, or at the second ply if there are
+   several threads to keep busy, and count the subtrees in parallel */
+static int perft_parallel(game_t *g, int depth, int nthreads, struct hashtable_t *ht,
+		move_t *moves, int nmoves, unsigned long long *nnodes, double *hitrate,
+		unsigned long *nallocs)
+{
+	int split = nthreads > 1 && depth >= 3 ? 2 : 1;
+	struct job_t *jobs = malloc(nmoves * (split == 2 ? MOVES_MAX : 1) * sizeof(*jobs));
+	if (!jobs)
+		return 1;
+
+	int njobs = 0;
+	for (int k = 0; k < nmoves; ++k) {
+		if (split == 1) {
+			jobs[njobs++] = (struct job_t){ .nroot = k, .nplies = 1,
+				.plies = { moves[k] } };
+			continue;
+		}
+
+		move_t replies[MOVES_MAX];
+		if (game_exec_move_r(g, moves[k])) {
+			free(jobs);
+			return 1;
+		}
+		int nreplies = game_generate_legal_moves_r(g, replies);
+		game_undo_last_ply_r(g);
+		for (int l = 0; l < nreplies; ++l) {
+			jobs[njobs++] = (struct job_t){ .nroot = k, .nplies = 2,
+				.plies = { moves[k], replies[l] } };
+		}
+	}
+
+	struct jobqueue_t q = { .g = g, .depth = depth, .ht = ht, .jobs = jobs, .njobs = njobs };
+	pthread_mutex_init(&q.lock, NULL);
+
+	int err = 0;
+	pthread_t threads[THREADS_MAX];
+	int nstarted = 0;
+	for (; nstarted < nthreads; ++nstarted) {
+		if (pthread_create(&threads[nstarted], NULL, perft_thread, &q)) {
+			err = 1;
+			break;
+		}
+	}
+	for (int k = 0; k < nstarted; ++k) {
+		void *ret;
+		pthread_join(threads[k], &ret);
+		err |= ret != NULL;
+	}
+	pthread_mutex_destroy(&q.lock);
+
+	for (int k = 0; k < nmoves; ++k)
+		nnodes[k] = 0;
+	unsigned long long nprobes = 0;
+	unsigned long long nhits = 0;
+	for (int k = 0; k < njobs; ++k) {
+		nnodes[jobs[k].nroot] += jobs[k].nnodes;
+		nprobes += jobs[k].nprobes;
+		nhits += jobs[k].nhits;
+	}
+	*hitrate = nprobes ? (double)nhits / nprobes : 0;
+	*nallocs = q.nallocs;
+
+	free(jobs);
+	return err;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: pwn-perft [-j threads] [-H hashsize in MB] depth [fen]\n");
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	long nthreads = 1;
+	long hashmb = HASHTABLE_MB_DEFAULT;
+	int c;
+	while ((c = getopt(argc, argv, "j:H:")) != -1) {
+		char *e;
+		switch (c) {
+		case 'j':
+			e = parse_number(optarg, &nthreads);
+			if (!e || *e != '\0' || nthreads < 1 || nthreads > THREADS_MAX)
+				usage();
+			break;
+		case 'H':
+			e = parse_number(optarg, &hashmb);
+			if (!e || *e != '\0' || hashmb < 0 || hashmb > (1L << 20))
+				usage();
+			break;
+		default:
+			usage();
+		}
+	}
+	argc -= optind;
+	argv += optind;
+	if (argc < 1 || argc > 2)
+		usage();
+
+	long depth;
+	char *e = parse_number(argv[0], &depth);
+	if (!e || *e != '\0' || depth < 1 || depth > DEPTH_MAX)
+		usage();
+
+	const char *fen = argc == 2 ? argv[1] : STARTPOS_FEN;
+	game_t *g = game_create(fen);
+	if (!g) {
+		fprintf(stderr, "invalid fen '%s'\n", fen);
+		exit(1);
+	}
+
+	struct hashtable_t ht;
+	if (hashtable_init(&ht, hashmb)) {
+		fprintf(stderr, "could not allocate hash table\n");
+		exit(1);
+	}
+
+	long t = measure_time();
+
+	/* divide: count the nodes below every root move separately */
+	move_t moves[MOVES_MAX];
+	unsigned long long nnodes[MOVES_MAX];
+	int nmoves = game_generate_legal_moves_r(g, moves);
+	double hitrate;
+	unsigned long nallocs;
+	if (perft_parallel(g, depth, nthreads, &ht, moves, nmoves, nnodes, &hitrate, &nallocs)) {
+		fprintf(stderr, "could not run all perft threads\n");
+		exit(1);
+	}
+
+	t = measure_time() - t;
+
+	unsigned long long ntotal = 0;
+	for (int k = 0; k < nmoves; ++k) {
+		char move[MOVE_COORD_MAXLEN + 1];
+		move[format_move_coordinates(moves[k], move)] = '\0';
+		printf("%s: %llu\n", move, nnodes[k]);
+		ntotal += nnodes[k];
+	}
+	printf("\nnodes: %llu\n", ntotal);
+	printf("threads: %li\n", nthreads);
+	printf("allocations: %lu\n", nallocs);
+	if (ht.entries) {
+		printf("hash hits: %.1f %%\n", 100 * hitrate);
+		printf("hash occupancy: %.1f %%\n", 100 * hashtable_occupancy(&ht));
+	}
+	printf("time: %.3f s\n", (double)t / SECOND);
+	if (t > 0)
+		printf("nps: %.0f\n", (double)ntotal * SECOND / t);
+
+	free(ht.entries);
+	game_destroy(g);
+	return 0;
+}
@@ -23,8 +23,7 @@
 #include <stdlib.h>
 #include <errno.h>
 
-#include <X11/Xdefs.h>
-#include <cairo/cairo-xlib.h>
+#include <pthread.h>
 
 #define PROGNAME "pwn"
 #ifndef DATADIR
@@ -63,6 +62,7 @@ struct handler_t {
 struct handler_context_t {
 	struct handler_t gfxh;
 	struct handler_t audioh;
+	struct handler_t engineh;
 
 	pthread_mutex_t gamelock;
 	pthread_mutex_t xlock;
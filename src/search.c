@@ -0,0 +1,411 @@
+/*  pwn - simple multiplayer chess game
+ *
+ *  Copyright (C) 2020 Jona Ackerschott
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "search.h"
+#include "util.h"
+
+/* nodes between two looks at the clock and the interrupt */
+#define POLL_INTERVAL 2048
+
+#define HISTORY_MAX (1 << 20)
+
+/* move ordering classes, from the first move to try to the last */
+#define ORDER_TT (1 << 30)
+#define ORDER_GOOD_CAPTURE (1 << 28)
+#define ORDER_KILLER (1 << 27)
+#define ORDER_BAD_CAPTURE (-(1 << 28))
+
+enum {
+	BOUND_NONE,
+	BOUND_UPPER,
+	BOUND_LOWER,
+	BOUND_EXACT,
+};
+struct ttentry_t {
+	uint64_t key;
+	move_t move;
+	int16_t score;
+	int8_t depth;
+	uint8_t bound;
+};
+
+struct search_t {
+	struct ttentry_t *tt;
+	uint64_t ttmask;
+
+	/* move lists by ply, kept here instead of on the stack of the
+	   searching thread */
+	move_t moves[SEARCH_PLY_MAX][MOVES_MAX];
+	int order[SEARCH_PLY_MAX][MOVES_MAX];
+
+	/* quiet moves that caused a cutoff, by ply and by squares */
+	move_t killers[SEARCH_PLY_MAX][2];
+	int history[SQUARES_NUM][SQUARES_NUM];
+
+	const struct search_limits_t *limits;
+	long deadline;
+	unsigned long nodes;
+	int stopped;
+	int error;
+
+	move_t rootmove;
+	int rootscore;
+};
+
+/* mate scores are stored relative to the node instead of the root */
+static int score_to_tt(int score, int ply)
+{
+	if (score >= SCORE_MATE - SEARCH_PLY_MAX)
+		return score + ply;
+	if (score <= -SCORE_MATE + SEARCH_PLY_MAX)
+		return score - ply;
+	return score;
+}
+static int score_from_tt(int score, int ply)
+{
+	if (score >= SCORE_MATE - SEARCH_PLY_MAX)
+		return score - ply;
+	if (score <= -SCORE_MATE + SEARCH_PLY_MAX)
+		return score + ply;
+	return score;
+}
+static void store_tt(search_t *s, uint64_t key, move_t m, int score, int depth, int bound, int ply)
+{
+	struct ttentry_t *e = &s->tt[key & s->ttmask];
+	if (e->key == key && e->depth > depth && bound != BOUND_EXACT)
+		return;
+
+	e->key = key;
+	e->move = m;
+	e->score = score_to_tt(score, ply);
+	e->depth = depth;
+	e->bound = bound;
+}
+
+static int poll_stop(search_t *s)
+{
+	const struct search_limits_t *l = s->limits;
+	if (s->stopped)
+		return 1;
+
+	if (l->nodes && s->nodes >= l->nodes) {
+		s->stopped = 1;
+	} else if (s->nodes % POLL_INTERVAL == 0) {
+		if (s->deadline && measure_time() >= s->deadline)
+			s->stopped = 1;
+		else if (l->interrupt && l->interrupt(l->arg))
+			s->stopped = 1;
+	}
+	return s->stopped;
+}
+
+/* captures and promotions, the moves the quiescence search looks at */
+static int is_noisy(const game_t *g, move_t m)
+{
+	int to = MOVE_TO(m);
+	return game_get_piece_r(g, SQ_FILE(to), SQ_RANK(to)) != PIECE_NONE
+		|| MOVE_FLAGS(m) == MOVE_FLAG_EN_PASSANT
+		|| MOVE_FLAGS(m) == MOVE_FLAG_PROMOTION;
+}
+/* give every move of ply an ordering key, with noisyonly quiet moves,
+   losing captures and underpromotions are dropped instead */
+static int order_moves(search_t *s, const game_t *g, int ply, int n, move_t ttmove, int noisyonly)
+{
+	move_t *moves = s->moves[ply];
+	int *order = s->order[ply];
+	int nkept = 0;
+	for (int k = 0; k < n; ++k) {
+		move_t m = moves[k];
+		int key;
+		if (is_noisy(g, m)) {
+			piece_t prompiece = MOVE_PROMPIECE(m);
+			if (noisyonly && prompiece != PIECE_NONE && prompiece != PIECE_QUEEN)
+				continue;
+
+			int see = game_see_r(g, m);
+			if (noisyonly && see < 0)
+				continue;
+
+			/* most valuable victim first, least valuable attacker next */
+			int to = MOVE_TO(m);
+			int from = MOVE_FROM(m);
+			piece_t victim = game_get_piece_r(g, SQ_FILE(to), SQ_RANK(to));
+			int gain = victim != PIECE_NONE ? game_get_piece_value(victim) : 0;
+			if (prompiece != PIECE_NONE)
+				gain += game_get_piece_value(prompiece);
+			key = 16 * gain + PIECE_IDX(game_get_piece_r(g, SQ_FILE(from), SQ_RANK(from)));
+			key += see >= 0 ? ORDER_GOOD_CAPTURE : ORDER_BAD_CAPTURE;
+		} else if (noisyonly) {
+			continue;
+		} else if (m == s->killers[ply][0]) {
+			key = ORDER_KILLER + 1;
+		} else if (m == s->killers[ply][1]) {
+			key = ORDER_KILLER;
+		} else {
+			key = s->history[MOVE_FROM(m)][MOVE_TO(m)];
+		}
+		if (m == ttmove)
+			key = ORDER_TT;
+
+		moves[nkept] = m;
+		order[nkept] = key;
+		++nkept;
+	}
+	return nkept;
+}
+/* move the best of the remaining moves to position k */
+static move_t pick_move(search_t *s, int ply, int k, int n)
+{
+	move_t *moves = s->moves[ply];
+	int *order = s->order[ply];
+	int best = k;
+	for (int l = k + 1; l < n; ++l) {
+		if (order[l] > order[best])
+			best = l;
+	}
+
+	move_t m = moves[best];
+	int key = order[best];
+	moves[best] = moves[k];
+	order[best] = order[k];
+	moves[k] = m;
+	order[k] = key;
+	return m;
+}
+static void update_quiet_stats(search_t *s, int ply, move_t m, int depth)
+{
+	if (s->killers[ply][0] != m) {
+		s->killers[ply][1] = s->killers[ply][0];
+		s->killers[ply][0] = m;
+	}
+
+	int *h = &s->history[MOVE_FROM(m)][MOVE_TO(m)];
+	*h += depth * depth;
+	if (*h >= HISTORY_MAX) {
+		for (int from = 0; from < SQUARES_NUM; ++from) {
+			for (int to = 0; to < SQUARES_NUM; ++to)
+				s->history[from][to] /= 2;
+		}
+	}
+}
+
+static int exec_move(search_t *s, game_t *g, move_t m)
+{
+	if (game_exec_move_r(g, m)) {
+		s->error = 1;
+		s->stopped = 1;
+		return 1;
+	}
+	++s->nodes;
+	return 0;
+}
+
+/* only noisy moves are followed until the position is quiet, the side to
+   move may always stand pat unless it is in check */
+static int quiesce(search_t *s, game_t *g, int ply, int alpha, int beta)
+{
+	if (poll_stop(s))
+		return 0;
+
+	int check = game_is_check_r(g);
+	int best = -SCORE_INF;
+	if (!check) {
+		best = game_evaluate_r(g);
+		if (best >= beta || ply >= SEARCH_PLY_MAX - 1)
+			return best;
+		alpha = MAX(alpha, best);
+	} else if (ply >= SEARCH_PLY_MAX - 1) {
+		return game_evaluate_r(g);
+	}
+
+	int n = game_generate_legal_moves_r(g, s->moves[ply]);
+	if (n == 0)
+		return check ? -SCORE_MATE + ply : 0;
+	n = order_moves(s, g, ply, n, MOVE_NONE, !check);
+
+	for (int k = 0; k < n; ++k) {
+		move_t m = pick_move(s, ply, k, n);
+		if (exec_move(s, g, m))
+			return 0;
+		int score = -quiesce(s, g, ply + 1, -beta, -alpha);
+		game_undo_last_ply_r(g);
+		if (s->stopped)
+			return 0;
+
+		if (score > best) {
+			best = score;
+			if (score > alpha)
+				alpha = score;
+			if (alpha >= beta)
+				break;
+		}
+	}
+	return best;
+}
+static int search(search_t *s, game_t *g, int depth, int ply, int alpha, int beta)
+{
+	if (ply > 0 && game_is_repetition_r(g))
+		return 0;
+
+	/* a check is never the last ply looked at */
+	int check = game_is_check_r(g);
+	if (check)
+		++depth;
+	if (depth <= 0)
+		return quiesce(s, g, ply, alpha, beta);
+	if (poll_stop(s))
+		return 0;
+
+	uint64_t key = game_get_hash_r(g);
+	struct ttentry_t *e = &s->tt[key & s->ttmask];
+	move_t ttmove = MOVE_NONE;
+	if (e->key == key && e->bound != BOUND_NONE) {
+		ttmove = e->move;
+		int score = score_from_tt(e->score, ply);
+		if (ply > 0 && e->depth >= depth && (e->bound == BOUND_EXACT
+				|| (e->bound == BOUND_LOWER && score >= beta)
+				|| (e->bound == BOUND_UPPER && score <= alpha)))
+			return score;
+	}
+	if (ply >= SEARCH_PLY_MAX - 1)
+		return game_evaluate_r(g);
+
+	int n = game_generate_legal_moves_r(g, s->moves[ply]);
+	if (n == 0)
+		return check ? -SCORE_MATE + ply : 0;
+	n = order_moves(s, g, ply, n, ttmove, 0);
+
+	int alphaorig = alpha;
+	int best = -SCORE_INF;
+	move_t bestmove = MOVE_NONE;
+	for (int k = 0; k < n; ++k) {
+		move_t m = pick_move(s, ply, k, n);
+		int quiet = !is_noisy(g, m);
+		if (exec_move(s, g, m))
+			return 0;
+		int score = -search(s, g, depth - 1, ply + 1, -beta, -alpha);
+		game_undo_last_ply_r(g);
+		if (s->stopped)
+			return 0;
+
+		if (score <= best)
+			continue;
+		best = score;
+		bestmove = m;
+		if (score <= alpha)
+			continue;
+
+		alpha = score;
+		if (ply == 0) {
+			s->rootmove = m;
+			s->rootscore = score;
+		}
+		if (alpha >= beta) {
+			if (quiet)
+				update_quiet_stats(s, ply, m, depth);
+			break;
+		}
+	}
+
+	int bound = best >= beta ? BOUND_LOWER : best > alphaorig ? BOUND_EXACT : BOUND_UPPER;
+	store_tt(s, key, bestmove, best, depth, bound, ply);
+	return best;
+}
+
+search_t *search_create(size_t ttsize)
+{
+	search_t *s = malloc(sizeof(*s));
+	if (!s)
+		return NULL;
+
+	/* largest power of two number of entries that fits */
+	uint64_t n = 1;
+	while (2 * n * sizeof(*s->tt) <= ttsize)
+		n *= 2;
+
+	s->tt = calloc(n, sizeof(*s->tt));
+	if (!s->tt) {
+		free(s);
+		return NULL;
+	}
+	s->ttmask = n - 1;
+	search_clear(s);
+	return s;
+}
+void search_destroy(search_t *s)
+{
+	free(s->tt);
+	free(s);
+}
+void search_clear(search_t *s)
+{
+	memset(s->tt, 0, (s->ttmask + 1) * sizeof(*s->tt));
+	memset(s->killers, 0, sizeof(s->killers));
+	memset(s->history, 0, sizeof(s->history));
+}
+
+int search_run(search_t *s, game_t *g, const struct search_limits_t *limits,
+		struct search_result_t *res)
+{
+	memset(res, 0, sizeof(*res));
+	int n = game_generate_legal_moves_r(g, s->moves[0]);
+	if (n == 0)
+		return 1;
+
+	/* have a move at hand even if the first iteration is cut short */
+	res->move = s->moves[0][0];
+
+	long tstart = measure_time();
+	s->limits = limits;
+	s->deadline = limits->time ? tstart + limits->time : 0;
+	s->nodes = 0;
+	s->stopped = 0;
+	s->error = 0;
+	memset(s->killers, 0, sizeof(s->killers));
+
+	int maxdepth = limits->depth ? MIN(limits->depth, SEARCH_DEPTH_MAX) : SEARCH_DEPTH_MAX;
+	for (int depth = 1; depth <= maxdepth; ++depth) {
+		s->rootmove = MOVE_NONE;
+		int score = search(s, g, depth, 0, -SCORE_INF, SCORE_INF);
+		if (s->error)
+			return -1;
+
+		/* moves of an unfinished iteration are kept, the first one
+		   searched is the best of the last iteration */
+		if (s->rootmove != MOVE_NONE) {
+			res->move = s->rootmove;
+			res->score = s->rootscore;
+		}
+		if (s->stopped)
+			break;
+		res->score = score;
+		res->depth = depth;
+
+		/* the next iteration would not finish in time anyway */
+		if (limits->time && measure_time() - tstart > limits->time / 2)
+			break;
+		if (n == 1 && limits->time)
+			break;
+	}
+	res->nodes = s->nodes;
+	return 0;
+}
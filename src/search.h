@@ -0,0 +1,69 @@
+/*  pwn - simple multiplayer chess game
+ *
+ *  Copyright (C) 2020 Jona Ackerschott
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <stddef.h>
+
+#include "game.h"
+
+#define SEARCH_DEPTH_MAX 64
+#define SEARCH_PLY_MAX 128
+
+/* scores are centipawns for the side to move, a mate in n plies is
+   scored as SCORE_MATE - n */
+#define SCORE_INF 32000
+#define SCORE_MATE 31000
+#define SCORE_IS_MATE(s) ((s) >= SCORE_MATE - SEARCH_PLY_MAX \
+		|| (s) <= -SCORE_MATE + SEARCH_PLY_MAX)
+
+/* a limit of 0 means no limit, the time is in nanoseconds. interrupt
+   is asked every few thousand nodes and stops the search as soon as it
+   returns nonzero */
+struct search_limits_t {
+	int depth;
+	unsigned long nodes;
+	long time;
+	int (*interrupt)(void *arg);
+	void *arg;
+};
+/* the best move of the deepest iteration, which may not have been
+   completed if a limit was hit in between */
+struct search_result_t {
+	move_t move;
+	int score;
+	int depth;
+	unsigned long nodes;
+};
+
+/* a searcher with its own transposition table of about ttsize bytes,
+   searchers are independent of each other like games are */
+typedef struct search_t search_t;
+
+search_t *search_create(size_t ttsize);
+void search_destroy(search_t *s);
+void search_clear(search_t *s);
+
+/* iterative deepening alpha-beta search of the current position of g,
+   which is left unchanged. Returns 1 if there is no legal move and -1
+   if the game history could not grow */
+int search_run(search_t *s, game_t *g, const struct search_limits_t *limits,
+		struct search_result_t *res);
+
+#endif /* SEARCH_H */
@@ -0,0 +1,64 @@
+/*  pwn - simple multiplayer chess game
+ *
+ *  Copyright (C) 2020 Jona Ackerschott
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/* tables generated at build time by gentables, private to bitboard.c */
+
+#ifndef TABLES_H
+#define TABLES_H
+
+#include "bitboard.h"
+
+/* number of relevant occupancy subsets summed over all squares */
+#define ROOK_TABLE_SIZE 102400
+#define BISHOP_TABLE_SIZE 5248
+
+/* directions of the rays, the first four run towards higher squares
+   and direction k + 4 is opposite to direction k */
+enum {
+	RAY_EAST,
+	RAY_NORTH,
+	RAY_NORTHEAST,
+	RAY_NORTHWEST,
+	RAY_WEST,
+	RAY_SOUTH,
+	RAY_SOUTHWEST,
+	RAY_SOUTHEAST,
+	RAYS_NUM,
+};
+
+struct magic_t {
+	bitboard_t mask;
+	bitboard_t magic;
+	unsigned int offset;
+	int shift;
+};
+
+/* squares reached from a square in one direction on an empty board */
+extern const bitboard_t rays[RAYS_NUM][SQUARES_NUM];
+
+extern const struct magic_t rook_magics[SQUARES_NUM];
+extern const struct magic_t bishop_magics[SQUARES_NUM];
+
+/* slider attacks for every relevant occupancy, indexed by magic
+   multiplication or by pext, which enumerate the subsets differently */
+extern const bitboard_t rook_table_magic[ROOK_TABLE_SIZE];
+extern const bitboard_t bishop_table_magic[BISHOP_TABLE_SIZE];
+extern const bitboard_t rook_table_pext[ROOK_TABLE_SIZE];
+extern const bitboard_t bishop_table_pext[BISHOP_TABLE_SIZE];
+
+#endif /* TABLES_H */
@@ -1,6 +1,19 @@
 #ifndef UTIL_H
 #define UTIL_H
 
+#include <stddef.h>
+#include <time.h>
+
+#include "notation.h"
+
+/* monotonic clock in nanoseconds, for measuring intervals */
+static inline long measure_time(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * SECOND + ts.tv_nsec;
+}
+
 int hread(int fd, void *buf, size_t size);
 int hwrite(int fd, void *buf, size_t size);
 int hrecv(int fd, char *buf, size_t size);
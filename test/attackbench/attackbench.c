@@ -0,0 +1,78 @@
+#include "test.h"
+#include "bitboard.h"
+#include "util.h"
+
+#define OCCUPANCIES_NUM 4096
+#define ROUNDS_NUM 64
+
+static const char *method_names[] = {
+	"ray walk",
+	"magic",
+	"pext",
+};
+
+static bitboard_t occupancies[OCCUPANCIES_NUM];
+static bitboard_t reference[OCCUPANCIES_NUM][SQUARES_NUM];
+
+static bitboard_t random_bitboard(void)
+{
+	static bitboard_t x = 0x9e3779b97f4a7c15ULL;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	return x * 0x2545f4914f6cdd1dULL;
+}
+
+static void bench_method(int method)
+{
+	if (bb_set_slider_method(method)) {
+		printf("%-8s: not supported on this cpu\n", method_names[method]);
+		return;
+	}
+
+	int nwrong = 0;
+	for (int k = 0; k < OCCUPANCIES_NUM; ++k) {
+		for (int s = 0; s < SQUARES_NUM; ++s) {
+			bitboard_t b = bb_rook_attacks(s, occupancies[k])
+				| bb_bishop_attacks(s, occupancies[k]);
+			nwrong += b != reference[k][s];
+		}
+	}
+	TEST_EQUAL_I(nwrong, 0);
+
+	bitboard_t sum = 0;
+	long t = measure_time();
+	for (int r = 0; r < ROUNDS_NUM; ++r) {
+		for (int k = 0; k < OCCUPANCIES_NUM; ++k) {
+			for (int s = 0; s < SQUARES_NUM; ++s) {
+				sum += bb_rook_attacks(s, occupancies[k]);
+				sum += bb_bishop_attacks(s, occupancies[k]);
+			}
+		}
+	}
+	t = measure_time() - t;
+
+	long nlookups = 2L * ROUNDS_NUM * OCCUPANCIES_NUM * SQUARES_NUM;
+	printf("%-8s: %.2f ns per lookup (checksum %016llx)\n", method_names[method],
+			(double)t / nlookups, (unsigned long long)sum);
+}
+
+int main(void) {
+	bb_init();
+
+	/* sparse occupancies like in real positions */
+	for (int k = 0; k < OCCUPANCIES_NUM; ++k)
+		occupancies[k] = random_bitboard() & random_bitboard();
+
+	bb_set_slider_method(BB_SLIDERS_RAYS);
+	for (int k = 0; k < OCCUPANCIES_NUM; ++k) {
+		for (int s = 0; s < SQUARES_NUM; ++s) {
+			reference[k][s] = bb_rook_attacks(s, occupancies[k])
+				| bb_bishop_attacks(s, occupancies[k]);
+		}
+	}
+
+	for (int m = BB_SLIDERS_RAYS; m <= BB_SLIDERS_PEXT; ++m)
+		bench_method(m);
+	return 0;
+}
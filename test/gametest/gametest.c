@@ -1,7 +1,13 @@
 #include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 #include "test.h"
 #include "game.h"
+#include "mailbox.h"
+#include "nnue.h"
 #include "notation.h"
 
 static void print_fen()
@@ -16,63 +22,32 @@ static unsigned int get_possible_position_num(int depth, int print)
 	if (depth == 0)
 		return 1;
 
+	move_t moves[MOVES_MAX];
+	int nmoves = game_generate_legal_moves(moves);
+	if (depth == 1 && !print)
+		return nmoves;
+
 	unsigned int npositions = 0;
-	for (sqid n = 0; n < NF * NF * NF * NF; ++n) {
-		int n1 = n / (NF * NF);
-		int n2 = n % (NF * NF);
-
-		int i = n1 % NF;
-		int j = n1 / NF;
-		int k = n2 % NF;
-		int l = n2 / NF;
-
-		if (!game_is_movable_piece_at(i, j))
-			continue;
-
-		piece_t piece = game_get_piece(i, j);
-		int err = game_exec_ply(i, j, k, l, PIECE_NONE);
-		if (err == 0) {
-			unsigned int npos = get_possible_position_num(depth - 1, 0);
-
-			if (print) {
-				sqid from[] = {i, j};
-				sqid to[] = {k, l};
-				char move[5];
-				move[0] = FILE_CHAR(i);
-				move[1] = RANK_CHAR(j);
-				move[2] = FILE_CHAR(k);
-				move[3] = RANK_CHAR(l);
-				move[4] = '\0';
-				printf("%s: %u\n", move, npos);
-			}
-
-			game_undo_last_ply();
-			npositions += npos;
-			continue;
-		} else if (err == 1) {
-			continue;
-		}
+	for (int k = 0; k < nmoves; ++k) {
+		game_exec_move(moves[k]);
+		unsigned int npos = get_possible_position_num(depth - 1, 0);
+		game_undo_last_ply();
 
-		for (int p = PIECE_IDX(PIECE_QUEEN); p <= PIECE_IDX(PIECE_KNIGHT); ++p) {
-			err = game_exec_ply(i, j, k, l, PIECE_BY_IDX(p));
-			assert(!err);
-			unsigned int npos = get_possible_position_num(depth - 1, 0);
-
-			if (print) {
-				sqid from[] = {i, j};
-				sqid to[] = {k, l};
-				char move[5];
-				move[0] = FILE_CHAR(i);
-				move[1] = RANK_CHAR(j);
-				move[2] = FILE_CHAR(k);
-				move[3] = RANK_CHAR(l);
-				move[4] = '\0';
-				printf("%s: %u\n", move, npos);
-			}
-
-			game_undo_last_ply();
-			npositions += npos;
+		if (print) {
+			char move[6];
+			sqid from[2], to[2];
+			piece_t prompiece;
+			game_unpack_move(moves[k], from, to, &prompiece);
+			move[0] = FILE_CHAR(from[0]);
+			move[1] = RANK_CHAR(from[1]);
+			move[2] = FILE_CHAR(to[0]);
+			move[3] = RANK_CHAR(to[1]);
+			move[4] = prompiece ? "kqrbnp"[PIECE_IDX(prompiece)] : '\0';
+			move[5] = '\0';
+			printf("%s: %u\n", move, npos);
 		}
+
+		npositions += npos;
 	}
 
 	return npositions;
@@ -85,15 +60,462 @@ static unsigned int possible_positions_nums[] = {
 	1486,
 	62379,
 	2103487,
-	//89941194,
+	89941194,
 };
 
+static void test_repetition(void)
+{
+	/* knights out and back twice, the start position occurs three times */
+	static const move_t plies[] = {
+		MOVE(SQ(6, 0), SQ(5, 2)), MOVE(SQ(6, 7), SQ(5, 5)),
+		MOVE(SQ(5, 2), SQ(6, 0)), MOVE(SQ(5, 5), SQ(6, 7)),
+	};
+
+	game_load_fen(STARTPOS_FEN);
+	uint64_t hashstart = game_get_hash();
+
+	status_t status;
+	for (int n = 0; n < 2 * ARRNUM(plies); ++n) {
+		int err = game_exec_ply(plies[n % ARRNUM(plies)]);
+		TEST_EQUAL_I(err, 0);
+
+		status = game_get_active_color() ? STATUS_MOVING_BLACK : STATUS_MOVING_WHITE;
+		game_get_status(&status);
+		if (n < 2 * ARRNUM(plies) - 1)
+			TEST_EQUAL_I(status == STATUS_DRAW_REPETITION, 0);
+	}
+	TEST_EQUAL_I(status, STATUS_DRAW_REPETITION);
+	TEST_EQUAL_I(game_get_hash() == hashstart, 1);
+
+	/* the cached status must not survive the ply it belongs to */
+	game_undo_last_ply();
+	status = STATUS_MOVING_BLACK;
+	game_get_status(&status);
+	TEST_EQUAL_I(status, STATUS_MOVING_BLACK);
+
+	for (int n = 1; n < 2 * ARRNUM(plies); ++n)
+		game_undo_last_ply();
+	TEST_EQUAL_I(game_get_hash() == hashstart, 1);
+}
+
+static void test_promotion(void)
+{
+	sqid from[2] = {3, 6};
+	sqid to[2] = {2, 7};
+	move_t m = game_pack_move(from, to, PIECE_KNIGHT);
+	TEST_EQUAL_I(MOVE_PROMPIECE(m), PIECE_KNIGHT);
+
+	/* plain moves to the last rank ask for the promotion piece */
+	game_t *g = game_create(testpos_fen);
+	int err = game_exec_ply_r(g, game_pack_move(from, to, PIECE_NONE));
+	TEST_EQUAL_I(err, 2);
+	err = game_exec_ply_r(g, m);
+	TEST_EQUAL_I(err, 0);
+	TEST_EQUAL_I(game_get_piece_r(g, to[0], to[1]), PIECE_KNIGHT);
+	game_destroy(g);
+}
+
+static void test_copy(void)
+{
+	game_t *g = game_create(STARTPOS_FEN);
+	game_t *copy = game_copy(g);
+	int err = game_exec_ply_r(copy, MOVE(SQ(4, 1), SQ(4, 3)));
+	TEST_EQUAL_I(err, 0);
+
+	/* the original game must not see plies of the copy */
+	TEST_EQUAL_I(game_get_piece_r(g, 4, 1), PIECE_PAWN);
+	TEST_EQUAL_I(game_get_piece_r(copy, 4, 1), PIECE_NONE);
+	TEST_EQUAL_U(game_get_ply_number_r(g), 0);
+	TEST_EQUAL_I(game_get_hash_r(g) == game_get_hash_r(copy), 0);
+	TEST_EQUAL_I(game_is_same_position_r(g, copy), 0);
+
+	game_undo_last_ply_r(copy);
+	TEST_EQUAL_I(game_get_hash_r(g) == game_get_hash_r(copy), 1);
+	TEST_EQUAL_I(game_is_same_position_r(g, copy), 1);
+
+	/* positions without exactly one king per side are refused */
+	err = game_load_fen_r(copy, "8/8/8/8/8/8/8/K7 w - - 0 1");
+	TEST_EQUAL_I(err, 1);
+
+	/* and leave the game untouched */
+	TEST_EQUAL_I(game_is_same_position_r(g, copy), 1);
+	TEST_EQUAL_I(game_get_hash_r(g) == game_get_hash_r(copy), 1);
+	TEST_EQUAL_I(game_get_piece_r(copy, 4, 0), PIECE_KING);
+
+	game_destroy(copy);
+	game_destroy(g);
+}
+
+static void test_load_fen(void)
+{
+	game_t *g = game_create(STARTPOS_FEN);
+	char fen[FEN_BUFSIZE];
+
+	/* the side not to move must not be in check */
+	int err = game_load_fen_r(g, "4k3/8/8/8/8/8/4R3/4K3 w - - 0 1");
+	TEST_EQUAL_I(err, 1);
+	err = game_load_fen_r(g, "4k3/8/8/8/8/8/4R3/4K3 b - - 0 1");
+	TEST_EQUAL_I(err, 0);
+
+	/* nor may pawns stand on a back rank */
+	err = game_load_fen_r(g, "4k2P/8/8/8/8/8/8/4K3 b - - 0 1");
+	TEST_EQUAL_I(err, 1);
+
+	/* castle rights without king and rook at home are dropped */
+	err = game_load_fen_r(g, "4k3/8/8/8/8/8/8/4K3 w K - 0 1");
+	TEST_EQUAL_I(err, 0);
+	game_get_fen_r(g, fen);
+	int cmp = strcmp(fen, "4k3/8/8/8/8/8/8/4K3 w - - 0 1");
+	TEST_EQUAL_I(cmp, 0);
+	move_t moves[MOVES_MAX];
+	int nmoves = game_generate_legal_moves_r(g, moves);
+	TEST_EQUAL_I(nmoves, 5);
+
+	err = game_load_fen_r(g, "r3k2r/8/8/8/8/8/8/1R2K1R1 w KQkq - 0 1");
+	TEST_EQUAL_I(err, 0);
+	game_get_fen_r(g, fen);
+	cmp = strcmp(fen, "r3k2r/8/8/8/8/8/8/1R2K1R1 w kq - 0 1");
+	TEST_EQUAL_I(cmp, 0);
+
+	/* as is an en passant field no pawn has just passed */
+	err = game_load_fen_r(g, "4k3/8/8/8/8/8/8/4K3 w - e6 0 1");
+	TEST_EQUAL_I(err, 0);
+	game_get_fen_r(g, fen);
+	cmp = strcmp(fen, "4k3/8/8/8/8/8/8/4K3 w - - 0 1");
+	TEST_EQUAL_I(cmp, 0);
+
+	game_destroy(g);
+}
+
+static void test_legal_targets(void)
+{
+	game_t *g = game_create(STARTPOS_FEN);
+	uint64_t targets = game_get_legal_targets_r(g, 4, 1);
+	TEST_EQUAL_I(targets == ((uint64_t)1 << SQ(4, 2) | (uint64_t)1 << SQ(4, 3)), 1);
+	TEST_EQUAL_I(game_get_legal_targets_r(g, 4, 0) == 0, 1);
+
+	/* the targets belong to the position they were computed for */
+	game_exec_ply_r(g, MOVE(SQ(4, 1), SQ(4, 3)));
+	TEST_EQUAL_I(game_get_legal_targets_r(g, 4, 1) == 0, 1);
+	targets = game_get_legal_targets_r(g, 6, 7);
+	TEST_EQUAL_I(targets == ((uint64_t)1 << SQ(5, 5) | (uint64_t)1 << SQ(7, 5)), 1);
+	game_destroy(g);
+}
+
+static void test_material(void)
+{
+	static const struct {
+		const char *fen;
+		status_t status;
+		status_t expected;
+	} cases[] = {
+		{ "8/8/4k3/8/8/3NK3/8/8 w - - 0 1",
+			STATUS_MOVING_WHITE, STATUS_DRAW_MATERIAL },
+		{ "8/8/4k3/8/8/2B1K3/8/4B3 w - - 0 1",
+			STATUS_MOVING_WHITE, STATUS_DRAW_MATERIAL },
+		{ "8/8/4k3/8/8/2B1KB2/8/8 w - - 0 1",
+			STATUS_MOVING_WHITE, STATUS_MOVING_WHITE },
+		{ "8/8/4k3/8/3n4/8/4P3/4K3 w - - 0 1",
+			STATUS_TIMEOUT_WHITE, STATUS_TIMEOUT_WHITE },
+		{ "8/8/4k3/8/3n4/8/8/4K3 w - - 0 1",
+			STATUS_TIMEOUT_WHITE, STATUS_DRAW_MATERIAL_VS_TIMEOUT },
+	};
+
+	for (int k = 0; k < ARRNUM(cases); ++k) {
+		game_load_fen(cases[k].fen);
+		status_t status = cases[k].status;
+		game_get_status(&status);
+		TEST_EQUAL_I(status, cases[k].expected);
+	}
+
+	int nbishops = game_get_piece_count(COLOR_WHITE, PIECE_BISHOP);
+	TEST_EQUAL_I(nbishops, 0);
+	int nknights = game_get_piece_count(COLOR_BLACK, PIECE_KNIGHT);
+	TEST_EQUAL_I(nknights, 1);
+}
+
+static void test_see(void)
+{
+	static const struct {
+		const char *fen;
+		move_t move;
+		int expected;
+	} cases[] = {
+		/* pawn takes a knight and is taken back */
+		{ "4k3/8/2p5/3n4/4P3/8/8/4K3 w - - 0 1", MOVE(SQ(4, 3), SQ(3, 4)), 220 },
+		{ "4k3/8/2p5/3p4/8/8/3Q4/4K3 w - - 0 1", MOVE(SQ(3, 1), SQ(3, 4)), -800 },
+		{ "4k3/8/8/3n4/8/8/3R4/4K3 w - - 0 1", MOVE(SQ(3, 1), SQ(3, 4)), 320 },
+		/* the second rook recaptures through the first */
+		{ "4k3/3r4/8/3p4/8/8/3R4/3RK3 w - - 0 1", MOVE(SQ(3, 1), SQ(3, 4)), 100 },
+		/* a quiet move onto an attacked square hangs the queen */
+		{ "4k3/8/2p5/8/8/8/3Q4/4K3 w - - 0 1", MOVE(SQ(3, 1), SQ(3, 4)), -900 },
+	};
+
+	for (int k = 0; k < ARRNUM(cases); ++k) {
+		game_load_fen(cases[k].fen);
+		int see = game_see(cases[k].move);
+		TEST_EQUAL_I(see, cases[k].expected);
+	}
+}
+
+/* the kernels are checked against the scalar ones on random boards */
+static void test_mailbox(void)
+{
+	static const int kernels[] = { MB_KERNELS_SSE2, MB_KERNELS_AVX2 };
+	uint8_t a[SQUARES_NUM] __attribute__((aligned(MAILBOX_ALIGN)));
+	uint8_t b[SQUARES_NUM] __attribute__((aligned(MAILBOX_ALIGN)));
+
+	int defaultkernels = mb_get_kernels();
+	for (int n = 0; n < 64; ++n) {
+		for (int s = 0; s < SQUARES_NUM; ++s) {
+			a[s] = rand() % 4 ? PIECE_NONE : PIECE_BY_IDX(rand() % PIECES_NUM) | rand() % 2;
+			b[s] = a[s];
+		}
+		if (n % 2)
+			b[rand() % SQUARES_NUM] ^= COLORMASK;
+		squareinfo_t info = PIECE_BY_IDX(n % PIECES_NUM) | n / PIECES_NUM % 2;
+
+		mb_set_kernels(MB_KERNELS_SCALAR);
+		uint64_t found = mb_find(a, info, PIECEMASK | COLORMASK);
+		int count = mb_count(a, info & PIECEMASK, PIECEMASK);
+		int equal = mb_equal(a, b) != 0;
+		for (int k = 0; k < ARRNUM(kernels); ++k) {
+			if (mb_set_kernels(kernels[k]))
+				continue;
+			uint64_t kfound = mb_find(a, info, PIECEMASK | COLORMASK);
+			TEST_EQUAL_I(kfound == found, 1);
+			int kcount = mb_count(a, info & PIECEMASK, PIECEMASK);
+			TEST_EQUAL_I(kcount, count);
+			int kequal = mb_equal(a, b) != 0;
+			TEST_EQUAL_I(kequal, equal);
+		}
+	}
+	mb_set_kernels(defaultkernels);
+}
+
+static void test_psq_score(void)
+{
+	static const char *fen = "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1";
+	static const move_t moves[] = {
+		MOVE(SQ(4, 0), SQ(6, 0)),
+		MOVE(SQ(1, 3), SQ(2, 2)),
+		MOVE(SQ(3, 4), SQ(4, 5)),
+	};
+
+	game_t *g = game_create(fen);
+	int before = game_get_psq_score_r(g);
+	for (int k = 0; k < ARRNUM(moves); ++k)
+		game_exec_ply_r(g, moves[k]);
+
+	/* a knight for a pawn */
+	int balance = game_get_material_balance_r(g);
+	TEST_EQUAL_I(balance, -220);
+
+	char s[FEN_BUFSIZE];
+	game_get_fen_r(g, s);
+	game_t *fresh = game_create(s);
+	int score = game_get_psq_score_r(g);
+	int scorefresh = game_get_psq_score_r(fresh);
+	TEST_EQUAL_I(score, scorefresh);
+	game_destroy(fresh);
+
+	for (int k = 0; k < ARRNUM(moves); ++k)
+		game_undo_last_ply_r(g);
+	int after = game_get_psq_score_r(g);
+	TEST_EQUAL_I(after, before);
+	balance = game_get_material_balance_r(g);
+	TEST_EQUAL_I(balance, 0);
+	game_destroy(g);
+}
+
+/* small random weights, in the layout described in nnue.h */
+static int write_network(char *fname)
+{
+	int fd = mkstemp(fname);
+	if (fd == -1)
+		return 1;
+	FILE *f = fdopen(fd, "wb");
+
+	char header[64] = NNUE_MAGIC;
+	uint32_t dims[] = { NNUE_VERSION, NNUE_FEATURES, NNUE_HIDDEN, NNUE_L1 };
+	memcpy(header + 8, dims, sizeof(dims));
+	fwrite(header, sizeof(header), 1, f);
+
+	size_t nweights = (NNUE_FEATURES + 1) * NNUE_HIDDEN + NNUE_L1 * COLORS_NUM * NNUE_HIDDEN;
+	for (size_t k = 0; k < nweights; ++k) {
+		int16_t w = rand() % 32 - 16;
+		fwrite(&w, sizeof(w), 1, f);
+	}
+	for (int k = 0; k < NNUE_L1; ++k) {
+		int32_t b = rand() % 4096 - 2048;
+		fwrite(&b, sizeof(b), 1, f);
+	}
+	for (int k = 0; k < NNUE_L1; ++k) {
+		int16_t w = rand() % 64 - 32;
+		fwrite(&w, sizeof(w), 1, f);
+	}
+	int32_t b = 100;
+	fwrite(&b, sizeof(b), 1, f);
+	return fclose(f) != 0;
+}
+
+static void test_network(void)
+{
+	static const char *fen = "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1";
+	static const move_t moves[] = {
+		MOVE(SQ(4, 0), SQ(6, 0)),
+		MOVE(SQ(1, 3), SQ(2, 2)),
+		MOVE(SQ(3, 4), SQ(4, 5)),
+		MOVE(SQ(2, 6), SQ(2, 4)),
+	};
+
+	char fname[] = "/tmp/pwnnnueXXXXXX";
+	int err = write_network(fname);
+	TEST_EQUAL_I(err, 0);
+	err = game_load_network(fname);
+	unlink(fname);
+	TEST_EQUAL_I(err, 0);
+
+	/* the accumulator kept up to date by plies matches a fresh one */
+	game_t *g = game_create(fen);
+	int before = game_evaluate_r(g);
+	for (int k = 0; k < ARRNUM(moves); ++k) {
+		err = game_exec_ply_r(g, moves[k]);
+		TEST_EQUAL_I(err, 0);
+
+		char s[FEN_BUFSIZE];
+		game_get_fen_r(g, s);
+		game_t *fresh = game_create(s);
+		int eval = game_evaluate_r(g);
+		int evalfresh = game_evaluate_r(fresh);
+		TEST_EQUAL_I(eval, evalfresh);
+		game_destroy(fresh);
+	}
+	for (int k = 0; k < ARRNUM(moves); ++k)
+		game_undo_last_ply_r(g);
+	int after = game_evaluate_r(g);
+	TEST_EQUAL_I(after, before);
+
+	/* all kernels compute the same integers */
+	int kernels = nnue_get_kernels();
+	if (!nnue_set_kernels(NNUE_KERNELS_AVX2)) {
+		int avx2 = game_evaluate_r(g);
+		nnue_set_kernels(NNUE_KERNELS_SCALAR);
+		int scalar = game_evaluate_r(g);
+		TEST_EQUAL_I(avx2, scalar);
+		nnue_set_kernels(kernels);
+	}
+
+	/* a reloaded network may be mapped where the last one was, the
+	   accumulator must be rebuilt anyway */
+	char fname2[] = "/tmp/pwnnnueXXXXXX";
+	err = write_network(fname2);
+	TEST_EQUAL_I(err, 0);
+	err = game_load_network(fname2);
+	unlink(fname2);
+	TEST_EQUAL_I(err, 0);
+	game_t *fresh = game_create(fen);
+	int evalreload = game_evaluate_r(g);
+	int evalfresh = game_evaluate_r(fresh);
+	TEST_EQUAL_I(evalreload, evalfresh);
+	game_destroy(fresh);
+
+	game_load_network(NULL);
+	game_load_fen_r(g, STARTPOS_FEN);
+	int eval = game_evaluate_r(g);
+	TEST_EQUAL_I(eval, 0);
+	game_destroy(g);
+}
+
+static void write_book_entry(FILE *f, uint64_t key, unsigned int move, unsigned int weight)
+{
+	unsigned char e[16] = { 0 };
+	for (int k = 0; k < 8; ++k)
+		e[k] = key >> (56 - 8 * k);
+	e[8] = move >> 8;
+	e[9] = move;
+	e[10] = weight >> 8;
+	e[11] = weight;
+	fwrite(e, sizeof(e), 1, f);
+}
+
+static void test_book(void)
+{
+	/* keys of the positions after 1. e4 d5 2. e5 f5, of the start
+	   position, the first two from the polyglot documentation, and of a
+	   position where both sides can castle */
+	static const char *fens[] = {
+		"rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3",
+		STARTPOS_FEN,
+		"r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1",
+	};
+
+	char fname[] = "/tmp/pwnbookXXXXXX";
+	int fd = mkstemp(fname);
+	TEST_EQUAL_I(fd == -1, 0);
+	FILE *f = fdopen(fd, "wb");
+	write_book_entry(f, 0x22a48b5a8e47ff78ULL, 2349, 1);
+	write_book_entry(f, 0x463b96181691fc9cULL, 796, 10);
+	write_book_entry(f, 0x463b96181691fc9cULL, 804, 50);
+	write_book_entry(f, 0x463b96181691fc9cULL, 731, 20);
+	write_book_entry(f, 0xfda239cc692a6053ULL, 263, 1);
+	fclose(f);
+	int err = game_load_book(fname);
+	unlink(fname);
+	TEST_EQUAL_I(err, 0);
+
+	move_t moves[MOVES_MAX];
+	unsigned int weights[MOVES_MAX];
+	game_t *g = game_create(fens[0]);
+	int n = game_book_moves_r(g, moves, weights);
+	TEST_EQUAL_I(n, 1);
+	TEST_EQUAL_U(moves[0], MOVE(SQ(4, 4), SQ(5, 5)) | MOVE_FLAG_EN_PASSANT);
+
+	/* the illegal e2e5 is left out, d2d4 has more weight than e2e4 */
+	game_load_fen_r(g, fens[1]);
+	n = game_book_moves_r(g, moves, weights);
+	TEST_EQUAL_I(n, 2);
+	TEST_EQUAL_U(moves[0], MOVE(SQ(3, 1), SQ(3, 3)));
+	TEST_EQUAL_U(weights[0], 20);
+	TEST_EQUAL_U(moves[1], MOVE(SQ(4, 1), SQ(4, 3)));
+
+	/* the king takes its rook in the book */
+	game_load_fen_r(g, fens[2]);
+	n = game_book_moves_r(g, moves, NULL);
+	TEST_EQUAL_I(n, 1);
+	TEST_EQUAL_U(moves[0], MOVE(SQ(4, 0), SQ(6, 0)) | MOVE_FLAG_CASTLE);
+
+	game_load_fen_r(g, testpos_fen);
+	n = game_book_moves_r(g, moves, weights);
+	TEST_EQUAL_I(n, 0);
+
+	game_load_book(NULL);
+	game_destroy(g);
+}
+
 int main(void) {
 	game_init(testpos_fen);
+	long nallocs = game_get_allocation_count();
 	for (int i = 0; i < ARRNUM(possible_positions_nums); ++i) {
 		unsigned int npos = get_possible_position_num(i + 1, 1);
 		unsigned int nposref = possible_positions_nums[i];
 		TEST_EQUAL_U(npos, nposref);
 	}
+
+	/* trying out moves must not touch the allocator */
+	long nallocsperft = game_get_allocation_count();
+	TEST_EQUAL_LI(nallocsperft, nallocs);
+
+	test_repetition();
+	test_promotion();
+	test_copy();
+	test_load_fen();
+	test_mailbox();
+	test_legal_targets();
+	test_material();
+	test_see();
+	test_psq_score();
+	test_network();
+	test_book();
 	return 0;
 }
@@ -71,6 +71,20 @@ void test_move() {
 	}
 }
 
+void test_fen(const char *fen) {
+	squareinfo_t position[NF][NF];
+	color_t active_color;
+	int castlerights[2];
+	sqid fep[2];
+	unsigned int ndrawplies, nmove;
+	parse_fen(fen, position, &active_color, castlerights, fep, &ndrawplies, &nmove);
+
+	char s[FEN_BUFSIZE];
+	format_fen(position, active_color, castlerights, fep, ndrawplies, nmove, s);
+	printf("info: s = %s\n", s);
+	TEST_EQUAL_I(strcmp(s, fen), 0);
+}
+
 int main(void) {
 	struct timespec ts;
 	clock_gettime(CLOCK_REALTIME, &ts);
@@ -85,4 +99,7 @@ int main(void) {
 	test_timeinterval(dt);
 
 	test_move();
+
+	test_fen(STARTPOS_FEN);
+	test_fen("8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1");
 }
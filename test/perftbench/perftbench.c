@@ -0,0 +1,55 @@
+#include "test.h"
+#include "game.h"
+#include "util.h"
+
+#define ROUNDS_NUM 3
+
+static const struct {
+	const char *fen;
+	int depth;
+	unsigned long nnodes;
+} positions[] = {
+	{ "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 6, 119060324 },
+	{ "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 5, 193690690 },
+	{ "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 6, 11030083 },
+	{ "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 5, 15833292 },
+};
+
+static unsigned long perft(game_t *g, int depth)
+{
+	move_t moves[MOVES_MAX];
+	int nmoves = game_generate_legal_moves_r(g, moves);
+	if (depth == 1)
+		return nmoves;
+
+	unsigned long nnodes = 0;
+	for (int k = 0; k < nmoves; ++k) {
+		game_exec_move_r(g, moves[k]);
+		nnodes += perft(g, depth - 1);
+		game_undo_last_ply_r(g);
+	}
+	return nnodes;
+}
+
+int main(void) {
+	unsigned long ntotal = 0;
+	long tbest = 0;
+	for (int r = 0; r < ROUNDS_NUM; ++r) {
+		ntotal = 0;
+		long t = measure_time();
+		for (int k = 0; k < ARRNUM(positions); ++k) {
+			game_t *g = game_create(positions[k].fen);
+			unsigned long nnodes = perft(g, positions[k].depth);
+			TEST_EQUAL_LI((long)nnodes, (long)positions[k].nnodes);
+			ntotal += nnodes;
+			game_destroy(g);
+		}
+		t = measure_time() - t;
+		if (r == 0 || t < tbest)
+			tbest = t;
+	}
+
+	printf("perft: %lu nodes in %.3f s, %.1f Mnps\n", ntotal, tbest / 1e9,
+			ntotal * 1e3 / tbest);
+	return 0;
+}
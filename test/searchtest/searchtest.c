@@ -0,0 +1,74 @@
+#include "test.h"
+#include "game.h"
+#include "search.h"
+
+#define TT_SIZE (1 << 20)
+
+static void test_best_move(void)
+{
+	static const struct {
+		const char *fen;
+		int depth;
+		move_t move;
+		int score;
+	} cases[] = {
+		/* back rank mate */
+		{ "6k1/5ppp/8/8/8/8/8/R5K1 w - - 0 1", 2,
+			MOVE(SQ(0, 0), SQ(0, 7)), SCORE_MATE - 1 },
+		/* the rooks need a quiet move first */
+		{ "7k/8/8/8/8/8/R7/1R4K1 w - - 0 1", 4,
+			MOVE(SQ(1, 0), SQ(1, 6)), SCORE_MATE - 3 },
+		/* a hanging queen */
+		{ "4k3/8/8/3q4/8/8/8/3RK3 w - - 0 1", 3,
+			MOVE(SQ(3, 0), SQ(3, 4)), 0 },
+	};
+
+	search_t *s = search_create(TT_SIZE);
+	for (int k = 0; k < ARRNUM(cases); ++k) {
+		game_t *g = game_create(cases[k].fen);
+		struct search_limits_t limits = { .depth = cases[k].depth };
+		struct search_result_t res;
+		int err = search_run(s, g, &limits, &res);
+		TEST_EQUAL_I(err, 0);
+		TEST_EQUAL_I(res.move, cases[k].move);
+		if (cases[k].score)
+			TEST_EQUAL_I(res.score, cases[k].score);
+
+		/* the position is left as it was */
+		game_t *orig = game_create(cases[k].fen);
+		int same = game_is_same_position_r(g, orig);
+		TEST_EQUAL_I(same, 1);
+		game_destroy(orig);
+		game_destroy(g);
+	}
+	search_destroy(s);
+}
+
+static void test_limits(void)
+{
+	search_t *s = search_create(TT_SIZE);
+	game_t *g = game_create(STARTPOS_FEN);
+
+	struct search_limits_t limits = { .nodes = 10000 };
+	struct search_result_t res;
+	search_run(s, g, &limits, &res);
+	int moved = res.move != MOVE_NONE;
+	TEST_EQUAL_I(moved, 1);
+	int withinlimit = res.nodes <= limits.nodes;
+	TEST_EQUAL_I(withinlimit, 1);
+
+	/* no legal move in stalemate */
+	game_load_fen_r(g, "7k/5Q2/6K1/8/8/8/8/8 b - - 0 1");
+	int err = search_run(s, g, &limits, &res);
+	TEST_EQUAL_I(err, 1);
+
+	game_destroy(g);
+	search_destroy(s);
+}
+
+int main(void)
+{
+	test_best_move();
+	test_limits();
+	return 0;
+}